@@ -44,7 +44,7 @@ uint32_t CountSketch::median(int32_t res[]) const {
     std::sort(res, res + TABLE_DEPTH);
     int32_t mid = TABLE_DEPTH >> 1;
 
-    if((TABLE_DEPTH & 1) == 1)
+    if(TABLE_DEPTH % 2 == 1)
         return res[mid];
 
     return (res[mid-1] + res[mid]) >> 1;
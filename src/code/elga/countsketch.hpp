@@ -12,6 +12,14 @@
  * Please see the LICENSE.md file for license information.
  */
 
+#ifndef COUNTSKETCH_HPP
+#define COUNTSKETCH_HPP
+
+#ifndef TABLE_WIDTH
+#define TABLE_WIDTH 262144
+#define TABLE_DEPTH 8
+#endif
+
 #include "countsketchbase.hpp"
 #include "integer_hash.hpp"
 
@@ -49,3 +57,5 @@ class CountSketch : public CountSketchBase {
 
         static size_t size() { return sizeof(SharedTable); }
 };
+
+#endif
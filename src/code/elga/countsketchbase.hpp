@@ -14,6 +14,10 @@
  * Please see the LICENSE.md file for license information.
  */
 
+#ifndef COUNTSKETCHBASE_HPP
+#define COUNTSKETCHBASE_HPP
+
+#include <cstdint>
 #include <memory>
 #include <algorithm>
 #include <cstring>
@@ -25,3 +29,5 @@ class CountSketchBase {
         virtual void merge(CountSketchBase &cs) = 0;
         virtual char* serialize() = 0;
 };
+
+#endif
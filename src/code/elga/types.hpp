@@ -106,6 +106,24 @@ using it_t = int32_t;
 #define ALG_INTERNAL_COMPUTE      0xcf
 #define ALG_VERTICES              0xd0
 #define GET_STATE                 0xd1
+#define MAP_SCAN_BATCH            0xd2
+#define MAP_ADD_TAGS              0xd3
+#define MAP_REMOVE_TAGS           0xd4
+#define MAP_SET_VALUE             0xd5
+#define MAP_MODIFY_MULTIPLE       0xd6
+#define ADD_ENTRIES_BULK          0xd7
+#define IMPORT_DB_ROUTED          0xd8
+#define MULTI_OP                  0xd9
+#define GET_ENTRIES_BY_KEYS       0xda
+#define REPLICATE_KEY             0xdb
+#define FULL_SCAN_BROADCAST       0xdc
+#define FULL_SCAN                 0xdd
+#define QUERY_PAGE                0xde
+#define QUERY_NEXT                0xdf
+#define QUERY_CLOSE               0xe0
+#define AGGREGATE                 0xe1
+#define SET_MERGE_STRATEGY_BROADCAST 0xe2
+#define SET_MERGE_STRATEGY        0xe3
 #define WANT_HEARTBEAT            0xfe
 #define HEARTBEAT                 0xff
 
@@ -34,6 +34,11 @@ void btc_based_block_to_tx(const DBAccess *access, const char* crypto_tag, const
     auto &txs = d["tx"];
     if (!txs.IsArray()) return fail_(access, filter_fail_tag, filter_name, "txs was not an array");
 
+    // Write compact records unless the block asks for JSON
+    bool write_json = has_tag(access, TX_JSON_TAG);
+    int64_t block_time = d.HasMember("time") && d["time"].IsInt64() ? d["time"].GetInt64() : 0;
+    string record;
+
     // Iterate through each transaction
     for (auto & tx : txs.GetArray()) {
         // Pull out the txid
@@ -44,17 +49,24 @@ void btc_based_block_to_tx(const DBAccess *access, const char* crypto_tag, const
         string txid = txid_raw.GetString();
 
 
-        // Write out the tx to a string
-        Document n;
-        n.SetObject();
+        // Write out the tx to a string, falling back to JSON for anything
+        // the record cannot hold
+        StringBuffer buf;
+        const char* new_value;
+        if (!write_json && TxRecord::encode(tx, block_time, record)) {
+            new_value = record.c_str();
+        } else {
+            Document n;
+            n.SetObject();
 
-        Document::AllocatorType& allocator = n.GetAllocator();
+            Document::AllocatorType& allocator = n.GetAllocator();
 
-        n.AddMember("tx", tx, allocator);
+            n.AddMember("tx", tx, allocator);
 
-        StringBuffer buf;
-        PrettyWriter<StringBuffer> writer { buf };
-        n.Accept(writer);
+            PrettyWriter<StringBuffer> writer { buf };
+            n.Accept(writer);
+            new_value = buf.GetString();
+        }
 
 		// Create txid key for tx
 		chain_info_t tx_key = pack_chain_info(crypto_id, TX_KEY, 0);
@@ -68,7 +80,6 @@ void btc_based_block_to_tx(const DBAccess *access, const char* crypto_tag, const
 
         // Create new DB entries for each transaction
         const char* new_tags[] = {crypto_tag, "tx", txid_tag.c_str(), ""};
-        const char* new_value = buf.GetString();
 
         access->make_new_entry.run(&access->make_new_entry, new_tags, new_value, new_key);
     }
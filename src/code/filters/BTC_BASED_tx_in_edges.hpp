@@ -39,6 +39,42 @@ bool should_run_btc_based_tx_in_edges(const DBAccess *access, const char* crypto
 void btc_based_tx_in_edges(const DBAccess *access, const char* crypto_tag, const char* filter_name, const char* filter_done_tag, const char* filter_fail_tag) {
     const uint32_t crypto_id = get_blockchain_key(crypto_tag);
 
+    string new_value; //TODO only a portion of the ID
+
+    auto coinbase_edge = [&]() {
+        const char* coinbase_tags[] = {crypto_tag, "tx-in-edge", "from=COINBASE", "n=0", ""};
+        access->make_new_entry.run(&access->make_new_entry, coinbase_tags, new_value.c_str(), INITIAL_KEY);
+    };
+    auto in_edge = [&](const string& src_id, int n) {
+        string n_str = to_string(n);
+        n_str = "n=" + n_str;
+
+        string src_id_tag = "from=" + src_id;
+
+        //set keys and make new entry
+        const char* new_tags[] = {crypto_tag, "tx-in-edge", src_id_tag.c_str(), n_str.c_str(), ""};
+        chain_info_t crypto_key = pack_chain_info(crypto_id, TX_IN_EDGE_KEY, 0);
+        vtx_t n_key = n;
+        vtx_t src_key;
+        stringstream ss;
+        ss << src_id.substr(0,15);
+        ss >> hex >> src_key;
+        dbkey_t new_key {crypto_key, src_key, n_key};
+        access->make_new_entry.run(&access->make_new_entry, new_tags, new_value.c_str(), new_key);
+    };
+
+    if (TxRecord::is_record(access->value)) {
+        TxRecord tx;
+        if (!tx.parse(access->value)) return fail_(access, filter_name, filter_fail_tag);
+        new_value = tx.txid;
+        for (auto & vin : tx.vin) {
+            if (vin.coinbase) coinbase_edge();
+            else in_edge(string(vin.txid), vin.vout);
+        }
+        access->add_tag.run(&access->add_tag, filter_done_tag);
+        return;
+    }
+
     // The value should be a valid JSON string
     Document d;
     d.Parse(access->value);
@@ -53,7 +89,7 @@ void btc_based_tx_in_edges(const DBAccess *access, const char* crypto_tag, const
     auto &txid = tx["txid"];
     if (!txid.IsString()) return fail_(access, filter_name, filter_fail_tag);
 
-    const char * new_value = txid.GetString(); //TODO only a portion of the ID
+    new_value = txid.GetString();
 
     if (!tx.HasMember("vin")) return fail_(access, filter_name, filter_fail_tag);
     auto &vins = tx["vin"];
@@ -62,8 +98,7 @@ void btc_based_tx_in_edges(const DBAccess *access, const char* crypto_tag, const
     for (auto& vin : vins.GetArray()) {
         if (vin.HasMember("coinbase")) {
             //Coinbase transaction
-            const char* coinbase_tags[] = {crypto_tag, "tx-in-edge", "from=COINBASE", "n=0", ""};
-            access->make_new_entry.run(&access->make_new_entry, coinbase_tags, new_value, INITIAL_KEY);
+            coinbase_edge();
         } else {
             //Non-coinbase transaction
             if (!vin["vout"].IsInt() || !vin["txid"].IsString()) {
@@ -72,26 +107,7 @@ void btc_based_tx_in_edges(const DBAccess *access, const char* crypto_tag, const
             }
 
             // Pull the txid and vout from the "vin" object
-            auto vin_txid = vin["txid"].GetString();
-            int n = vin["vout"].GetInt();
-            string n_str = to_string(n);
-            n_str = "n=" + n_str;
-
-            string src_id;
-            src_id.assign(vin_txid);
-            string src_id_tag = "from=" + src_id;
-
-            //set keys and make new entry
-            const char* new_tags[] = {crypto_tag, "tx-in-edge", src_id_tag.c_str(), n_str.c_str(), ""};
-            chain_info_t crypto_key = pack_chain_info(crypto_id, TX_IN_EDGE_KEY, 0);
-            vtx_t n_key = n;
-            vtx_t src_key;
-            stringstream ss;
-            ss << src_id.substr(0,15);
-            ss >> hex >> src_key;
-            dbkey_t new_key {crypto_key, src_key, n_key};
-            access->make_new_entry.run(&access->make_new_entry, new_tags, new_value, new_key);
-
+            in_edge(vin["txid"].GetString(), vin["vout"].GetInt());
         }
 
     }
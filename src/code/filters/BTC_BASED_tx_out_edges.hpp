@@ -39,40 +39,11 @@ bool should_run_btc_based_tx_out_edges(const DBAccess *access, const char* crypt
 void btc_based_tx_out_edges(const DBAccess *access, const char* crypto_tag, const char* filter_name, const char* filter_done_tag, const char* filter_fail_tag, const char* filter_inactive_tag) {
     const uint32_t crypto_id = get_blockchain_key(crypto_tag);
 	
-    // The value should be a valid JSON string
-    Document d;
-    d.Parse(access->value);
-
-    if (d.HasParseError()) return fail_(access, filter_name, filter_fail_tag, "cannot parse");
-
-    // Find the transactions in the block
-    if (!d.HasMember("tx")) return fail_(access, filter_name, filter_fail_tag, "no member tx");
-    auto &tx = d["tx"];
-    if (!tx.IsObject()) return fail_(access, filter_name, filter_fail_tag, "tx is not an object");
-    if (!tx.HasMember("txid")) return fail_(access, filter_name, filter_fail_tag, "txid not found");
-    auto &txid = tx["txid"];
-    if (!txid.IsString()) return fail_(access, filter_name, filter_fail_tag, "txid is not a string");
-
-    // Get the src ID (stored in the txid DB entry)
-    string src = txid.GetString();
-    string src_id = "from=" + src;
-
-    // In a BTC transaction, the txid is the source
-    // We are only outputting "out" edges
-    // So, we need to get and output each destination
-    // We know that inputs have already been processed, so every edge already exists
-    // We need to add values to them, and output unspent transactions
-    if (!tx.HasMember("vout")) return fail_(access, filter_name, filter_fail_tag, "no vout object");
-    auto &vouts = tx["vout"];
-    if (!vouts.IsArray()) return fail_(access, filter_name, filter_fail_tag, "vout is not an array");
-
+    string src;
     bool has_utxo = false;
 
-    for (auto & vout: vouts.GetArray()) {
-        // Find the position
-        if (!vout.HasMember("n")) return fail_(access, filter_name, filter_fail_tag, "no 'n' in vout");
-        if (!vout["n"].IsInt()) return fail_(access, filter_name, filter_fail_tag, "'n' is not an int");
-        int n = vout["n"].GetInt();
+    // Output the edge for the output at position n
+    auto out_edge = [&](int n, double value) {
         string n_str = to_string(n);
         n_str = "n=" + n_str;
 
@@ -104,10 +75,6 @@ void btc_based_tx_out_edges(const DBAccess *access, const char* crypto_tag, cons
         }
         string dst_id_tag = "to=" + dst_id;
 
-        // Find the (currency) value
-        if (!vout.HasMember("value")) return fail_(access, filter_name, filter_fail_tag, "no value found in vout");
-        if (!vout["value"].IsDouble()) return fail_(access, filter_name, filter_fail_tag, "value is not an int");
-        double value = vout["value"].GetDouble();
         string value_str = to_string(value);
 
         // Create the output edge
@@ -135,9 +102,54 @@ void btc_based_tx_out_edges(const DBAccess *access, const char* crypto_tag, cons
         // "n_key" is the "n" value if UTXO, but dst_tx_id if not a utxo
         dbkey_t new_key {crypto_key, src_key, n_key};
 
+        string src_id = "from=" + src;
         const char* new_tags[] = {crypto_tag, "tx-out-edge", src_id.c_str(), dst_id_tag.c_str(), ""};
         access->make_new_entry.run(&access->make_new_entry, new_tags, new_value, new_key);
-
+    };
+
+    if (TxRecord::is_record(access->value)) {
+        TxRecord tx;
+        if (!tx.parse(access->value)) return fail_(access, filter_name, filter_fail_tag, "cannot parse record");
+        src = tx.txid;
+        for (auto & vout : tx.vout) out_edge(vout.n, vout.value);
+    } else {
+        // The value should be a valid JSON string
+        Document d;
+        d.Parse(access->value);
+
+        if (d.HasParseError()) return fail_(access, filter_name, filter_fail_tag, "cannot parse");
+
+        // Find the transactions in the block
+        if (!d.HasMember("tx")) return fail_(access, filter_name, filter_fail_tag, "no member tx");
+        auto &tx = d["tx"];
+        if (!tx.IsObject()) return fail_(access, filter_name, filter_fail_tag, "tx is not an object");
+        if (!tx.HasMember("txid")) return fail_(access, filter_name, filter_fail_tag, "txid not found");
+        auto &txid = tx["txid"];
+        if (!txid.IsString()) return fail_(access, filter_name, filter_fail_tag, "txid is not a string");
+
+        // Get the src ID (stored in the txid DB entry)
+        src = txid.GetString();
+
+        // In a BTC transaction, the txid is the source
+        // We are only outputting "out" edges
+        // So, we need to get and output each destination
+        // We know that inputs have already been processed, so every edge already exists
+        // We need to add values to them, and output unspent transactions
+        if (!tx.HasMember("vout")) return fail_(access, filter_name, filter_fail_tag, "no vout object");
+        auto &vouts = tx["vout"];
+        if (!vouts.IsArray()) return fail_(access, filter_name, filter_fail_tag, "vout is not an array");
+
+        for (auto & vout: vouts.GetArray()) {
+            // Find the position
+            if (!vout.HasMember("n")) return fail_(access, filter_name, filter_fail_tag, "no 'n' in vout");
+            if (!vout["n"].IsInt()) return fail_(access, filter_name, filter_fail_tag, "'n' is not an int");
+            int n = vout["n"].GetInt();
+
+            // Find the (currency) value
+            if (!vout.HasMember("value")) return fail_(access, filter_name, filter_fail_tag, "no value found in vout");
+            if (!vout["value"].IsDouble()) return fail_(access, filter_name, filter_fail_tag, "value is not an int");
+            out_edge(n, vout["value"].GetDouble());
+        }
     }
 
     if (has_utxo) {
@@ -37,6 +37,43 @@ bool should_run_btc_based_vout_addrs(const DBAccess *access, const char* crypto_
 void btc_based_vout_addrs(const DBAccess *access, const char* crypto_tag, const char* filter_name, const char* filter_done_tag, const char* filter_fail_tag) {
     const uint32_t crypto_id = get_blockchain_key(crypto_tag);
 	
+    string txid;
+    vtx_t txid_key;
+
+    // Link the addresses to the output at position n
+    auto vout_addrs = [&](int n, const vector<string_view>& addrs) {
+        vtx_t n_key = n;
+        chain_info_t ci = pack_chain_info(crypto_id, VOUT_ADDR_KEY, 0);
+        dbkey_t new_key {ci, txid_key, n_key};
+        string new_val = "";
+        bool first = true;
+        for (auto & address : addrs) {
+            if (!first) {
+                new_val += "\n";
+            }
+            new_val += address;
+            first = false;
+        }
+
+        const char* new_tags[] = {crypto_tag, "VOUT_ADDRESS", ""};
+        access->make_new_entry.run(&access->make_new_entry, new_tags, new_val.c_str(), new_key);
+    };
+
+    if (TxRecord::is_record(access->value)) {
+        TxRecord tx;
+        if (!tx.parse(access->value)) return fail_(access, filter_name, filter_fail_tag, "cannot parse record");
+        txid = tx.txid;
+        stringstream ss;
+        ss << txid.substr(0,15);
+        ss >> hex >> txid_key;
+
+        for (auto & vout : tx.vout)
+            if (vout.has_addresses) vout_addrs(vout.n, vout.addresses);
+
+        access->add_tag.run(&access->add_tag, filter_done_tag);
+        return;
+    }
+
     // The value should be a valid JSON string
     Document d;
     d.Parse(access->value);
@@ -51,10 +88,9 @@ void btc_based_vout_addrs(const DBAccess *access, const char* crypto_tag, const
     if (!tx.HasMember("txid")) return fail_(access, filter_name, filter_fail_tag, "txid not found");
     auto &txid_raw = tx["txid"];
     if (!txid_raw.IsString()) return fail_(access, filter_name, filter_fail_tag, "txid is not a string");
-    string txid = txid_raw.GetString();
+    txid = txid_raw.GetString();
     stringstream ss;
     ss << txid.substr(0,15);
-    vtx_t txid_key;
     ss >> hex >> txid_key;
 
     if (!tx.HasMember("vout")) return fail_(access, filter_name, filter_fail_tag, "no vout object");
@@ -66,7 +102,6 @@ void btc_based_vout_addrs(const DBAccess *access, const char* crypto_tag, const
         if (!vout.HasMember("n")) return fail_(access, filter_name, filter_fail_tag, "no 'n' in vout");
         if (!vout["n"].IsInt()) return fail_(access, filter_name, filter_fail_tag, "'n' is not an int");
         int n = vout["n"].GetInt();
-        vtx_t n_key = n;
 
         // Now, pull out address information to link an address to this tx_output
         // REMEMBER! Not all transactions have associated addresses, that's fine
@@ -76,23 +111,12 @@ void btc_based_vout_addrs(const DBAccess *access, const char* crypto_tag, const
         if (!scriptPubKey.HasMember("addresses")) continue;
         auto &addrs = scriptPubKey["addresses"];
         if (!addrs.IsArray()) return fail_(access, filter_name, filter_fail_tag, "\"addresses\" was not an array");
-        chain_info_t ci = pack_chain_info(crypto_id, VOUT_ADDR_KEY, 0);
-        dbkey_t new_key {ci, txid_key, n_key};
-        string new_val = "";
-        bool first = true;
+        vector<string_view> addresses;
         for (auto & addr : addrs.GetArray()) {
-            if (!first) {
-                new_val += "\n";
-            }
             if (!addr.IsString()) return fail_(access, filter_name, filter_fail_tag, "address was not a string");
-            string address = addr.GetString();
-            new_val += address;
-            first = false;
-
+            addresses.emplace_back(addr.GetString(), addr.GetStringLength());
         }
-
-        const char* new_tags[] = {crypto_tag, "VOUT_ADDRESS", ""};
-        access->make_new_entry.run(&access->make_new_entry, new_tags, new_val.c_str(), new_key);
+        vout_addrs(n, addresses);
 
     }
 
@@ -22,6 +22,16 @@ static const char* filter_name = FILTER_NAME;
 static const char* filter_done_tag = FILTER_NAME ":done";
 static const char* filter_fail_tag = FILTER_NAME ":fail";
 
+// Only entries matching these are considered for should_run
+static const char* predicate_required_tags[] = {"BTC", "block", ""};
+static const char* predicate_forbidden_tags[] = {FILTER_NAME ":done", FILTER_NAME ":fail", ""};
+static const FilterPredicate predicate {
+    required_tags: predicate_required_tags,
+    forbidden_tags: predicate_forbidden_tags,
+    key_a_mask: 0,
+    key_a_value: 0
+};
+
 template<typename ...Args>
 void fail_(const DBAccess *access, Args && ...args) {
     cerr << "[ERROR] unable to run filter: " << filter_name;
@@ -175,7 +185,9 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: &predicate,
+        thread_safe: true
     };
 }
 
@@ -17,6 +17,16 @@ static const char* filter_name = FILTER_NAME;
 static const char* filter_done_tag = FILTER_NAME ":done";
 static const char* filter_fail_tag = FILTER_NAME ":fail";
 
+// Only entries matching these are considered for should_run
+static const char* predicate_required_tags[] = {CRYPTO_TAG, "block", ""};
+static const char* predicate_forbidden_tags[] = {FILTER_NAME ":done", FILTER_NAME ":fail", ""};
+static const FilterPredicate predicate {
+    required_tags: predicate_required_tags,
+    forbidden_tags: predicate_forbidden_tags,
+    key_a_mask: 0,
+    key_a_value: 0
+};
+
 void run_(const DBAccess *access) {
     return btc_based_block_number_to_tx(access, crypto_tag, filter_name, filter_fail_tag, filter_done_tag);
 }
@@ -40,7 +50,9 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: &predicate,
+        thread_safe: true
     };
 }
 
@@ -22,6 +22,16 @@ static const char* filter_fail_tag = FILTER_NAME ":fail";
 static const char* filter_inactive_tag = FILTER_NAME ":inactive";
 static const char* filter_first_run_tag = FILTER_NAME ":first_run_complete";
 
+// Only entries matching these are considered for should_run
+static const char* predicate_required_tags[] = {"BTC", "tx-in-edge", ""};
+static const char* predicate_forbidden_tags[] = {FILTER_NAME ":done", FILTER_NAME ":fail", FILTER_NAME ":inactive", ""};
+static const FilterPredicate predicate {
+    required_tags: predicate_required_tags,
+    forbidden_tags: predicate_forbidden_tags,
+    key_a_mask: 0,
+    key_a_value: 0
+};
+
 
 template<typename ...Args>
 void fail_(const DBAccess *access, Args && ...args) {
@@ -81,24 +91,31 @@ void run_(const DBAccess *access) {
             free(val_ret);
             
             // sum the vouts
-           Document tx_doc;
-           tx_doc.Parse(full_tx.c_str());
-           if (tx_doc.HasParseError()) return fail_(access, filter_fail_tag, filter_name, "parse error");
-           if (!tx_doc.HasMember("tx")) return fail_(access, filter_name, filter_fail_tag, "had no member \"tx\"");
-           auto &tx = tx_doc["tx"];
-           if (!tx.HasMember("vout")) return fail_(access, filter_name, filter_fail_tag, "tx had no member \"vout\"");
-           auto &vouts = tx["vout"];
-           if (!vouts.IsArray()) return fail_(access, filter_name, filter_fail_tag, "\"vouts\" was not an array");
            double vout_sum = 0;
-           for (rapidjson::Value::ConstValueIterator itr = vouts.Begin(); itr != vouts.End(); ++itr) {
-               const rapidjson::Value& vout = *itr;
-               if (!vout.HasMember("value")) return fail_(access, filter_name, filter_fail_tag, "vout had no member \"value\"");
-               auto val = vout["value"].GetFloat();
-               vout_sum += val;
+           if (TxRecord::is_record(full_tx.c_str())) {
+               TxRecord record;
+               if (!record.parse(full_tx.c_str())) return fail_(access, filter_name, filter_fail_tag, "cannot parse record");
+               for (auto & vout : record.vout)
+                   vout_sum += (float)vout.value;
+               val_s = to_string(vout_sum);
+           } else {
+               Document tx_doc;
+               tx_doc.Parse(full_tx.c_str());
+               if (tx_doc.HasParseError()) return fail_(access, filter_fail_tag, filter_name, "parse error");
+               if (!tx_doc.HasMember("tx")) return fail_(access, filter_name, filter_fail_tag, "had no member \"tx\"");
+               auto &tx = tx_doc["tx"];
+               if (!tx.HasMember("vout")) return fail_(access, filter_name, filter_fail_tag, "tx had no member \"vout\"");
+               auto &vouts = tx["vout"];
+               if (!vouts.IsArray()) return fail_(access, filter_name, filter_fail_tag, "\"vouts\" was not an array");
+               for (rapidjson::Value::ConstValueIterator itr = vouts.Begin(); itr != vouts.End(); ++itr) {
+                   const rapidjson::Value& vout = *itr;
+                   if (!vout.HasMember("value")) return fail_(access, filter_name, filter_fail_tag, "vout had no member \"value\"");
+                   auto val = vout["value"].GetFloat();
+                   vout_sum += val;
            }
 
            val_s = to_string(vout_sum);
-
+           }
 
         } else {
             access->add_tag.run(&access->add_tag, filter_inactive_tag);
@@ -206,7 +223,9 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: &predicate,
+        thread_safe: true
     };
 }
 
@@ -8,6 +8,7 @@
 #include <iomanip>
 
 #include "rapidjson/document.h"
+#include "helpers.hpp"
 
 using namespace std;
 using namespace pando;
@@ -18,6 +19,16 @@ static const char* filter_name = FILTER_NAME;
 static const char* filter_done_tag = FILTER_NAME ":done";
 static const char* filter_fail_tag = FILTER_NAME ":fail";
 
+// Only entries matching these are considered for should_run
+static const char* predicate_required_tags[] = {"BTC", "tx", ""};
+static const char* predicate_forbidden_tags[] = {FILTER_NAME ":done", FILTER_NAME ":fail", ""};
+static const FilterPredicate predicate {
+    required_tags: predicate_required_tags,
+    forbidden_tags: predicate_forbidden_tags,
+    key_a_mask: 0,
+    key_a_value: 0
+};
+
 template<typename ...Args>
 void fail_(const DBAccess *access, Args && ...args) {
     cerr << "[ERROR] unable to run filter: " << filter_name;
@@ -32,6 +43,59 @@ void run_(const DBAccess *access) {
     const char* new_tags_output[] = {"BTC", "tx_outputs.csv", "CROSSCHAIN_DATASET", ""};
     const char* new_tags_tx_to_output[] = {"BTC", "tx_to_outputs.csv", "CROSSCHAIN_DATASET", ""};
 
+    string txid;
+    vtx_t txid_key;
+
+    // Create the entries for the output at position n, returning its id
+    auto output = [&](int n, double value) {
+        vtx_t n_key = n;
+
+        // slightly unintuitive to use TX_IN_EDGE_KEY here, but we want to match IDs with in-edges
+        chain_info_t ci = pack_chain_info(BTC_KEY, TX_IN_EDGE_KEY, 0);
+        dbkey_t new_key {ci, n_key, txid_key};
+
+        stringstream tx_output_id_ss;
+        tx_output_id_ss << new_key.a << new_key.b << new_key.c;
+        string tx_output_id = tx_output_id_ss.str();
+
+        stringstream new_val_ss;
+        new_val_ss << tx_output_id << "," << value;
+        string new_value = new_val_ss.str();
+
+        // Use INITIAL_KEY here. the "new_key" we created was just to match the tx-in-edge, but with a different value
+        access->make_new_entry.run(&access->make_new_entry, new_tags_output, new_value.c_str(), INITIAL_KEY);
+
+        // Next, use information we already have to create the tx_to_output entry
+        stringstream tx_to_o_ss;
+        tx_to_o_ss << txid << "," << tx_output_id;
+        string new_val_tx_to_o = tx_to_o_ss.str();
+
+        access->make_new_entry.run(&access->make_new_entry, new_tags_tx_to_output, new_val_tx_to_o.c_str(), INITIAL_KEY);
+        return tx_output_id;
+    };
+    auto address = [&](string_view addr, const string& tx_output_id) {
+        stringstream addr_val_ss;
+        addr_val_ss << addr << "," << tx_output_id;
+        string addr_val = addr_val_ss.str();
+        access->make_new_entry.run(&access->make_new_entry, new_tags_addr_to_output, addr_val.c_str(), INITIAL_KEY);
+    };
+
+    if (TxRecord::is_record(access->value)) {
+        TxRecord tx;
+        if (!tx.parse(access->value)) return fail_(access, "cannot parse record");
+        txid = tx.txid;
+        stringstream ss;
+        ss << txid.substr(0,15);
+        ss >> hex >> txid_key;
+
+        for (auto & vout : tx.vout) {
+            string tx_output_id = output(vout.n, vout.value);
+            for (auto & addr : vout.addresses) address(addr, tx_output_id);
+        }
+        access->add_tag.run(&access->add_tag, filter_done_tag);
+        return;
+    }
+
     Document d;
     d.Parse(access->value);
 
@@ -45,10 +109,9 @@ void run_(const DBAccess *access) {
     if (!tx.HasMember("txid")) return fail_(access, "txid not found");
     auto &txid_raw = tx["txid"];
     if (!txid_raw.IsString()) return fail_(access, "txid is not a string");
-    string txid = txid_raw.GetString();
+    txid = txid_raw.GetString();
     stringstream ss;
     ss << txid.substr(0,15);
-    vtx_t txid_key;
     ss >> hex >> txid_key;
 
     if (!tx.HasMember("vout")) return fail_(access, "no vout object");
@@ -60,34 +123,13 @@ void run_(const DBAccess *access) {
         if (!vout.HasMember("n")) return fail_(access, "no 'n' in vout");
         if (!vout["n"].IsInt()) return fail_(access, "'n' is not an int");
         int n = vout["n"].GetInt();
-        vtx_t n_key = n;
 
         // Get the transaction value
         if (!vout.HasMember("value")) return fail_(access, "no value found in vout");
         if (!vout["value"].IsDouble()) return fail_(access, "value is not an int");
         double value = vout["value"].GetDouble();
 
-        // slightly unintuitive to use TX_IN_EDGE_KEY here, but we want to match IDs with in-edges
-        chain_info_t ci = pack_chain_info(BTC_KEY, TX_IN_EDGE_KEY, 0);
-        dbkey_t new_key {ci, n_key, txid_key};
-
-        stringstream tx_output_id_ss;
-        tx_output_id_ss << new_key.a << new_key.b << new_key.c;
-        string tx_output_id = tx_output_id_ss.str();
-
-        stringstream new_val_ss;
-        new_val_ss << tx_output_id << "," << value;
-        string new_value = new_val_ss.str();
-
-        // Use INITIAL_KEY here. the "new_key" we created was just to match the tx-in-edge, but with a different value
-        access->make_new_entry.run(&access->make_new_entry, new_tags_output, new_value.c_str(), INITIAL_KEY);
-
-        // Next, use information we already have to create the tx_to_output entry
-        stringstream tx_to_o_ss;
-        tx_to_o_ss << txid << "," << tx_output_id;
-        string new_val_tx_to_o = tx_to_o_ss.str();
-
-        access->make_new_entry.run(&access->make_new_entry, new_tags_tx_to_output, new_val_tx_to_o.c_str(), INITIAL_KEY);
+        string tx_output_id = output(n, value);
 
         // Now, pull out address information to link an address to this tx_output
         // REMEMBER! Not all transactions have associated addresses, that's fine
@@ -99,11 +141,7 @@ void run_(const DBAccess *access) {
         if (!addrs.IsArray()) return fail_(access, "\"addresses\" was not an array");
         for (auto & addr : addrs.GetArray()) {
             if (!addr.IsString()) return fail_(access, "address was not a string");
-            stringstream addr_val_ss;
-            addr_val_ss << addr.GetString() << "," << tx_output_id;
-            string addr_val = addr_val_ss.str();
-            access->make_new_entry.run(&access->make_new_entry, new_tags_addr_to_output, addr_val.c_str(), INITIAL_KEY);
-
+            address(addr.GetString(), tx_output_id);
         }
     }
 
@@ -148,7 +186,9 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: &predicate,
+        thread_safe: true
     };
 }
 
@@ -36,6 +36,8 @@ pub static filter: FilterInterface = {
         init: None,
         destroy: None,
         run: Some(run),
+        predicate: ::std::ptr::null(),
+        thread_safe: false,
     }
 };
 
@@ -1350,6 +1350,8 @@ pub struct DBAccess {
     pub value: *const ::std::os::raw::c_char,
     #[doc = " Members specific for GROUP_ENTRIES filters"]
     pub group: *mut ::std::os::raw::c_void,
+    #[doc = " Look up several keys in one call, as\n  run(fn, size_t num_keys, const dbkey_t* keys, char** values)\n Each value is malloc'd, or NULL when the key does not exist"]
+    pub get_entries_by_keys: fn_,
 }
 #[test]
 fn bindgen_test_layout_DBAccess() {
@@ -1357,7 +1359,7 @@ fn bindgen_test_layout_DBAccess() {
     let ptr = UNINIT.as_ptr();
     assert_eq!(
         ::std::mem::size_of::<DBAccess>(),
-        264usize,
+        288usize,
         concat!("Size of: ", stringify!(DBAccess))
     );
     assert_eq!(
@@ -1495,10 +1497,84 @@ fn bindgen_test_layout_DBAccess() {
             stringify!(group)
         )
     );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).get_entries_by_keys) as usize - ptr as usize },
+        264usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(DBAccess),
+            "::",
+            stringify!(get_entries_by_keys)
+        )
+    );
 }
 pub const filter_type_SINGLE_ENTRY: filter_type = 0;
 pub const filter_type_GROUP_ENTRIES: filter_type = 1;
 pub type filter_type = ::std::os::raw::c_uint;
+#[doc = " @brief Describes, by tags and key, which entries a filter may run on"]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct FilterPredicate {
+    pub required_tags: *const *const ::std::os::raw::c_char,
+    pub forbidden_tags: *const *const ::std::os::raw::c_char,
+    pub key_a_mask: chain_info_t,
+    pub key_a_value: chain_info_t,
+}
+#[test]
+fn bindgen_test_layout_FilterPredicate() {
+    const UNINIT: ::std::mem::MaybeUninit<FilterPredicate> = ::std::mem::MaybeUninit::uninit();
+    let ptr = UNINIT.as_ptr();
+    assert_eq!(
+        ::std::mem::size_of::<FilterPredicate>(),
+        32usize,
+        concat!("Size of: ", stringify!(FilterPredicate))
+    );
+    assert_eq!(
+        ::std::mem::align_of::<FilterPredicate>(),
+        8usize,
+        concat!("Alignment of ", stringify!(FilterPredicate))
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).required_tags) as usize - ptr as usize },
+        0usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(FilterPredicate),
+            "::",
+            stringify!(required_tags)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).forbidden_tags) as usize - ptr as usize },
+        8usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(FilterPredicate),
+            "::",
+            stringify!(forbidden_tags)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).key_a_mask) as usize - ptr as usize },
+        16usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(FilterPredicate),
+            "::",
+            stringify!(key_a_mask)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).key_a_value) as usize - ptr as usize },
+        24usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(FilterPredicate),
+            "::",
+            stringify!(key_a_value)
+        )
+    );
+}
 #[doc = " @brief Holds the tags and entry point for a filter"]
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
@@ -1512,6 +1588,8 @@ pub struct FilterInterface {
     >,
     pub destroy: ::std::option::Option<unsafe extern "C" fn(arg1: *mut ::std::os::raw::c_void)>,
     pub run: ::std::option::Option<unsafe extern "C" fn(arg1: *mut ::std::os::raw::c_void)>,
+    pub predicate: *const FilterPredicate,
+    pub thread_safe: bool,
 }
 #[test]
 fn bindgen_test_layout_FilterInterface() {
@@ -1519,7 +1597,7 @@ fn bindgen_test_layout_FilterInterface() {
     let ptr = UNINIT.as_ptr();
     assert_eq!(
         ::std::mem::size_of::<FilterInterface>(),
-        48usize,
+        64usize,
         concat!("Size of: ", stringify!(FilterInterface))
     );
     assert_eq!(
@@ -1587,6 +1665,26 @@ fn bindgen_test_layout_FilterInterface() {
             stringify!(run)
         )
     );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).predicate) as usize - ptr as usize },
+        48usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(FilterInterface),
+            "::",
+            stringify!(predicate)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).thread_safe) as usize - ptr as usize },
+        56usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(FilterInterface),
+            "::",
+            stringify!(thread_safe)
+        )
+    );
 }
 pub type __builtin_va_list = [__va_list_tag; 1usize];
 #[repr(C)]
@@ -4,9 +4,12 @@
 #include <cctype>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <string_view>
 #include "filter.hpp"
 #include "dbkey.h"
 #include "rapidjson/document.h"
+#include "rapidjson/internal/dtoa.h"
 #include "rapidjson/prettywriter.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/error/en.h"
@@ -119,3 +122,174 @@ long long sequence_to_bits(const string & sequence)
 
     return bit_representation;
 }
+
+/* ========================================================
+
+   Compact tx records
+
+   block_to_tx writes each transaction as one of these instead of as JSON,
+   so the filters reading tx entries neither store nor re-parse a JSON
+   document.  Values are passed around as C strings, so the record is text
+   with tab-separated fields, one line per part:
+
+     TX1 <txid> <block time, 0 if unknown>
+     C                                          (a coinbase input)
+     I <txid> <vout>                            (any other input)
+     O <n> <value> [<num addresses> <address>...]
+
+   The addresses are only there when the output lists them.  Blocks tagged
+   TX_JSON_TAG still get pretty-printed JSON tx entries, for debugging.
+
+   ======================================================== */
+
+const char* const TX_JSON_TAG = "tx_json";
+
+/** @brief A zero-copy view of a compact tx record
+ *
+ * The views point into the value that was parsed, which must outlive this.
+ */
+struct TxRecord {
+    struct In {
+        bool coinbase;
+        string_view txid;
+        int vout;
+    };
+    struct Out {
+        int n;
+        double value;
+        bool has_addresses;
+        vector<string_view> addresses;
+    };
+
+    string_view txid;
+    time_t time = 0;
+    vector<In> vin;
+    vector<Out> vout;
+
+    /** @brief Check whether a value holds a record, rather than JSON */
+    static bool is_record(const char* value) {
+        return strncmp(value, "TX1\t", 4) == 0;
+    }
+
+    /** @brief Parse a record, returning false if it is malformed */
+    bool parse(const char* value) {
+        vin.clear();
+        vout.clear();
+        if (!is_record(value)) return false;
+
+        const char* p = value + 4;
+        auto field = [&p]() {
+            const char* start = p;
+            while (*p != '\t' && *p != '\n' && *p != '\0') ++p;
+            string_view ret {start, (size_t)(p - start)};
+            if (*p == '\t') ++p;
+            return ret;
+        };
+        auto integer = [&p](auto& out) {
+            char* end;
+            out = strtoll(p, &end, 10);
+            if (end == p) return false;
+            p = end;
+            if (*p == '\t') ++p;
+            return true;
+        };
+        auto real = [&p](double& out) {
+            char* end;
+            out = strtod(p, &end);
+            if (end == p) return false;
+            p = end;
+            if (*p == '\t') ++p;
+            return true;
+        };
+
+        txid = field();
+        if (txid.empty() || !integer(time)) return false;
+
+        while (*p != '\0') {
+            if (*p++ != '\n') return false;
+            if (*p == '\0') break;
+            char kind = *p++;
+            if (kind == 'C') {
+                vin.push_back(In {true, {}, 0});
+            } else if (kind == 'I' && *p++ == '\t') {
+                In in {false, field(), 0};
+                if (!integer(in.vout)) return false;
+                vin.push_back(in);
+            } else if (kind == 'O' && *p++ == '\t') {
+                Out out {0, 0, false, {}};
+                if (!integer(out.n) || !real(out.value)) return false;
+                if (*p != '\n' && *p != '\0') {
+                    size_t num_addrs;
+                    if (!integer(num_addrs)) return false;
+                    out.has_addresses = true;
+                    for (size_t i = 0; i < num_addrs; ++i)
+                        out.addresses.push_back(field());
+                }
+                vout.push_back(move(out));
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @brief Write a JSON tx as a record
+     *
+     * @return false if the tx is missing parts of the record or has
+     *         fields of the wrong type, in which case it is left as JSON so
+     *         each filter reports the problem as before
+     */
+    static bool encode(const rapidjson::Value& tx, int64_t time, string& out) {
+        auto plain = [](const rapidjson::Value& v) {
+            return v.IsString() && strpbrk(v.GetString(), "\t\n") == nullptr && v.GetStringLength() > 0;
+        };
+        char num[32];
+        auto append_double = [&](double v) {
+            *rapidjson::internal::dtoa(v, num) = '\0';
+            out += num;
+        };
+
+        if (!tx.IsObject() || !tx.HasMember("txid") || !plain(tx["txid"])) return false;
+        if (!tx.HasMember("vin") || !tx["vin"].IsArray()) return false;
+        if (!tx.HasMember("vout") || !tx["vout"].IsArray()) return false;
+
+        out = "TX1\t";
+        out += tx["txid"].GetString();
+        out += "\t" + to_string(time);
+
+        for (auto & vin : tx["vin"].GetArray()) {
+            if (!vin.IsObject()) return false;
+            if (vin.HasMember("coinbase")) {
+                out += "\nC";
+                continue;
+            }
+            if (!vin.HasMember("txid") || !plain(vin["txid"])) return false;
+            if (!vin.HasMember("vout") || !vin["vout"].IsInt()) return false;
+            out += "\nI\t";
+            out += vin["txid"].GetString();
+            out += "\t" + to_string(vin["vout"].GetInt());
+        }
+
+        for (auto & vout : tx["vout"].GetArray()) {
+            if (!vout.IsObject()) return false;
+            if (!vout.HasMember("n") || !vout["n"].IsInt()) return false;
+            if (!vout.HasMember("value") || !vout["value"].IsDouble()) return false;
+            out += "\nO\t" + to_string(vout["n"].GetInt()) + "\t";
+            append_double(vout["value"].GetDouble());
+
+            if (!vout.HasMember("scriptPubKey")) continue;
+            auto &script = vout["scriptPubKey"];
+            if (!script.IsObject()) return false;
+            if (!script.HasMember("addresses")) continue;
+            auto &addrs = script["addresses"];
+            if (!addrs.IsArray()) return false;
+            out += "\t" + to_string(addrs.Size());
+            for (auto & addr : addrs.GetArray()) {
+                if (!plain(addr)) return false;
+                out += "\t";
+                out += addr.GetString();
+            }
+        }
+        return true;
+    }
+};
@@ -109,7 +109,9 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: nullptr,
+        thread_safe: true
     };
 }
 
@@ -25,7 +25,7 @@ void seq_count_kmers(const DBAccess *access, const char* filter_fail_tag, const
     // Create new DB entries for each transaction
     string val = string(access->value);
     val.erase(std::remove_if(val.begin(), val.end(), [](unsigned char c) { return std::isspace(c); }), val.end());
-    const char* new_tags[] = {"kmer_count", "k=15", "MERGE_STRATEGY_SUM", ""};
+    const char* new_tags[] = {"kmer_count", "k=15", "MERGE_STRATEGY=SUM", ""};
     if (val.empty())
     {
         access->add_tag.run(&access->add_tag, filter_fail_tag);
@@ -38,7 +38,7 @@ void seq_count_kmers(const DBAccess *access, const char* filter_fail_tag, const
     }
     long long b_key;
     dbkey_t new_key;
-    const char * new_value;
+    string new_value;
     for (const auto& pair : kmer_counts)
     {   
         try
@@ -58,8 +58,8 @@ void seq_count_kmers(const DBAccess *access, const char* filter_fail_tag, const
             return;
         }
         new_key = {KMER_COUNTS, b_key, 0};
-        new_value = to_string(pair.second).c_str();
-        access->make_new_entry.run(&access->make_new_entry, new_tags, new_value, new_key);
+        new_value = to_string(pair.second);
+        access->make_new_entry.run(&access->make_new_entry, new_tags, new_value.c_str(), new_key);
     }
 
     // Add a tag indicating parsing was successful
@@ -110,6 +110,8 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: nullptr,
+        thread_safe: true
     };
 }
@@ -92,6 +92,8 @@ extern "C" {
         should_run: &should_run,
         init: nullptr,
         destroy: nullptr,
-        run: &run
+        run: &run,
+        predicate: nullptr,
+        thread_safe: true
     };
 }
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+
+#include "dbkey.h"
+#include "pack.hpp"
+
+using namespace std;
+using namespace elga;
+
+namespace pando {
+
+/** @brief A partial count, sum, min and max over entries' values
+ *
+ * Each agent aggregates its own entries and the client merges the partial
+ * aggregates, so only these few numbers cross the network.  Values that do
+ * not parse as numbers are counted but otherwise ignored.
+ */
+struct Aggregate {
+    /** @brief Entries aggregated */
+    size_t count = 0;
+    /** @brief Entries whose value is a number */
+    size_t values = 0;
+    double sum = 0;
+    double min = numeric_limits<double>::infinity();
+    double max = -numeric_limits<double>::infinity();
+
+    /** @brief Add an entry's value */
+    void add(const char* value) {
+        ++count;
+        char* end;
+        double v = strtod(value, &end);
+        if (end == value) return;
+        while (*end == ' ' || *end == '\n' || *end == '\t') ++end;
+        if (*end != '\0') return;
+
+        ++values;
+        sum += v;
+        if (v < min) min = v;
+        if (v > max) max = v;
+    }
+
+    /** @brief Merge in another agent's partial aggregate */
+    void merge(const Aggregate& other) {
+        count += other.count;
+        values += other.values;
+        sum += other.sum;
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+
+    double mean() const { return values == 0 ? 0 : sum / values; }
+};
+
+/** @brief Aggregates by group */
+typedef map<string, Aggregate> aggregates_t;
+
+/** @brief Find the group an entry is aggregated in
+ *
+ * group_by is empty for a single group, "key.a", "key.b" or "key.c" to
+ * group by that key field, or otherwise a tag prefix (such as "month=")
+ * to group by the rest of the entry's first tag with that prefix.
+ *
+ * @return false if the entry has no tag with the prefix, and so is left out
+ */
+inline bool aggregate_group(const string& group_by, dbkey_t key, const char* const* c_tags, string& group) {
+    if (group_by.empty()) {
+        group.clear();
+    } else if (group_by == "key.a") {
+        group = to_string(key.a);
+    } else if (group_by == "key.b") {
+        group = to_string(key.b);
+    } else if (group_by == "key.c") {
+        group = to_string(key.c);
+    } else {
+        for (; (*c_tags)[0] != '\0'; ++c_tags) {
+            if (strncmp(*c_tags, group_by.c_str(), group_by.size()) == 0) {
+                group = *c_tags + group_by.size();
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+//aggregates format:
+//<num groups (size_t)>
+//  <group (null terminated)>
+//  <count (size_t)><values (size_t)><sum (double)><min (double)><max (double)>
+inline size_t aggregates_size(const aggregates_t& aggs) {
+    size_t ret = sizeof(size_t);
+    for (auto & [group, agg] : aggs)
+        ret += group.size() + 1 + 2*sizeof(size_t) + 3*sizeof(double);
+    return ret;
+}
+
+inline void pack_aggregates(char*& msg_ptr, const aggregates_t& aggs) {
+    pack_single(msg_ptr, aggs.size());
+    for (auto & [group, agg] : aggs) {
+        pack_string_null_term(msg_ptr, group);
+        pack_single(msg_ptr, agg.count);
+        pack_single(msg_ptr, agg.values);
+        pack_single(msg_ptr, agg.sum);
+        pack_single(msg_ptr, agg.min);
+        pack_single(msg_ptr, agg.max);
+    }
+}
+
+inline aggregates_t unpack_aggregates(const char*& data) {
+    aggregates_t aggs;
+    size_t num_groups = unpack_single<size_t>(data);
+    for (size_t i = 0; i < num_groups; ++i) {
+        string group {data};
+        data += group.size() + 1;
+        Aggregate& agg = aggs[group];
+        unpack_single(data, agg.count);
+        unpack_single(data, agg.values);
+        unpack_single(data, agg.sum);
+        unpack_single(data, agg.min);
+        unpack_single(data, agg.max);
+    }
+    return aggs;
+}
+
+}
@@ -57,7 +57,7 @@ class AlgDB : public SeqDB {
             // FIXME
             vector<DBEntry<>> ret_entries;
             if (!skip_group_filters_) {
-                ret_entries = db_.retrieve_all_entries();
+                ret_entries = db_->retrieve_all_entries();
             }
             for (auto & entry : ret_entries) {         // TODO : replace this with a C++ iterator that automatically "batches" behind the scene
                 if (entry.random_key()) continue;
@@ -93,7 +93,7 @@ class AlgDB : public SeqDB {
 
             vector<DBEntry<>> ret_entries;
             if (!skip_group_filters_) {
-                ret_entries = db_.retrieve_all_entries();
+                ret_entries = db_->retrieve_all_entries();
             }
             for (auto & entry : ret_entries) {         // TODO : replace this with a C++ iterator that automatically "batches" behind the scene
                 if (entry.random_key()) continue;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <exception>
 #include <cstring>
 #include <cstdio>
@@ -18,8 +19,27 @@ using namespace std;
 
 namespace pando {
 
+/** @brief A fixed-size region that large data is allocated from
+ *
+ * New blocks are carved off the end of the region.  Freed blocks of at least
+ * MIN_BLOCK bytes go on a free list for their size class (the floor of log2
+ * of their size) and are reused, splitting off any large enough remainder;
+ * smaller freed blocks, and the slack left when a reused block is not split,
+ * are counted as wasted.  Nothing is ever coalesced, so the only way to get
+ * the wasted bytes back is to copy the live data into a fresh region (see
+ * PandoMap::compact).
+ *
+ * A BigSpace is not thread safe; its owner must serialize allocations.
+ */
 class BigSpace {
+    public:
+        /** @brief The smallest block kept on a free list, which must hold
+         * the link and size of the free block */
+        constexpr static size_t MIN_BLOCK = sizeof(char*)+sizeof(size_t);
+
     private:
+        constexpr static size_t NUM_CLASSES = 64;
+
         char* space_;
         char* end_;
         char* ptr_;
@@ -29,8 +49,83 @@ class BigSpace {
         string fname_;
         string dname_;
         #endif
+
+        /** @brief The first free block of each size class */
+        char* free_[NUM_CLASSES];
+
+        /** @brief Bit c is set when free_[c] is not empty */
+        uint64_t free_classes_;
+
+        /** @brief Bytes handed out and not yet returned */
+        size_t live_;
+
+        /** @brief Bytes held on the free lists */
+        size_t free_bytes_;
+
+        /** @brief Bytes that were freed but can not be reused */
+        size_t wasted_;
+
+        static size_t size_class_(size_t size) {
+            return 63 - __builtin_clzll(size);
+        }
+
+        // Blocks have no alignment, so their headers are copied in and out
+        static char* block_next_(const char* block) {
+            char* next;
+            memcpy(&next, block, sizeof(char*));
+            return next;
+        }
+        static size_t block_size_(const char* block) {
+            size_t size;
+            memcpy(&size, block+sizeof(char*), sizeof(size_t));
+            return size;
+        }
+
+        /** @brief Put a block of at least MIN_BLOCK bytes on its free list */
+        void push_free_(char* block, size_t size) {
+            size_t c = size_class_(size);
+            memcpy(block, &free_[c], sizeof(char*));
+            memcpy(block+sizeof(char*), &size, sizeof(size_t));
+            free_[c] = block;
+            free_classes_ |= 1ull << c;
+            free_bytes_ += size;
+        }
+
+        /** @brief Take the first block of class c, keeping size bytes of it */
+        char* pop_free_(size_t c, size_t size) {
+            char* block = free_[c];
+            size_t block_size = block_size_(block);
+            free_[c] = block_next_(block);
+            if (free_[c] == nullptr) free_classes_ &= ~(1ull << c);
+            free_bytes_ -= block_size;
+
+            size_t rest = block_size - size;
+            if (rest >= MIN_BLOCK)
+                push_free_(block+size, rest);
+            else
+                wasted_ += rest;
+
+            return block;
+        }
+
+        /** @brief Return a free block of at least size bytes, or nullptr */
+        char* allocate_free_(size_t size) {
+            // Blocks are usually freed and requested in the same sizes, so
+            // first check whether the head of the size's own class fits
+            size_t c = size_class_(size);
+            if (free_[c] != nullptr && block_size_(free_[c]) >= size)
+                return pop_free_(c, size);
+
+            // Any block in a larger class fits
+            if (c+1 == NUM_CLASSES) return nullptr;
+            uint64_t larger = free_classes_ & (~0ull << (c+1));
+            if (larger == 0) return nullptr;
+            return pop_free_(__builtin_ctzll(larger), size);
+        }
+
     public:
-        BigSpace(size_t size=2ull*(1ull<<29)) : space_(nullptr), end_(nullptr), ptr_(nullptr), size_(size) {
+        BigSpace(size_t size=2ull*(1ull<<29)) : space_(nullptr), end_(nullptr), ptr_(nullptr), size_(size),
+                free_classes_(0), live_(0), free_bytes_(0), wasted_(0) {
             #ifdef CONFIG_BIGPIGO
             // Find an available file
             string dname;
@@ -55,6 +150,9 @@ class BigSpace {
 
             end_ = space_+size_+1;
             ptr_ = space_;
+
+            for (auto & block : free_)
+                block = nullptr;
         }
         ~BigSpace() {
             #ifdef CONFIG_BIGPIGO
@@ -68,19 +166,52 @@ class BigSpace {
         }
 
         void* allocate(size_t size) {
-            (void)ptr_;
-            if (ptr_ == end_) throw std::bad_alloc();
+            if (size >= MIN_BLOCK) {
+                char* res = allocate_free_(size);
+                if (res != nullptr) {
+                    live_ += size;
+                    return (void*)res;
+                }
+            }
+
+            if (size >= (size_t)(end_-ptr_)) throw std::bad_alloc();
             char* res = ptr_;
             ptr_ += size;
-            if (ptr_ >= end_) throw std::bad_alloc();
+            live_ += size;
             return (void*)res;
         }
 
-        void deallocate(void* ptr) {
-            // For now, no memory cleanup
-            (void)ptr;
+        void deallocate(void* ptr, size_t size) {
+            char* block = (char*)ptr;
+            live_ -= size;
+
+            if (block+size == ptr_)
+                // The last block carved off can simply be given back
+                ptr_ = block;
+            else if (size >= MIN_BLOCK)
+                push_free_(block, size);
+            else
+                wasted_ += size;
         }
 
+        /** @brief Return the size of the region */
+        size_t capacity() const { return size_; }
+
+        /** @brief Return the bytes carved off the region so far */
+        size_t used() const { return ptr_-space_; }
+
+        /** @brief Return the bytes currently allocated */
+        size_t live() const { return live_; }
+
+        /** @brief Return the bytes on the free lists, ready for reuse */
+        size_t free_bytes() const { return free_bytes_; }
+
+        /** @brief Return the bytes freed that can not be reused */
+        size_t wasted() const { return wasted_; }
+
+        /** @brief Return the bytes carved off that are not live */
+        size_t fragmented() const { return used()-live_; }
+
         BigSpace(const BigSpace& other) = delete;
         BigSpace(BigSpace&& other) noexcept = delete;
         BigSpace& operator=(const BigSpace& other) = delete;
@@ -94,6 +225,9 @@ class BigSpaceAllocator {
     public:
         using value_type = T;
         using is_always_equal = std::false_type;
+        /** Moving a container hands over its memory along with the space it
+         * came from, rather than copying into the target's space */
+        using propagate_on_container_move_assignment = std::true_type;
 
         BigSpaceAllocator() = delete;
         BigSpaceAllocator(std::shared_ptr<BigSpace> sp) : sp_(sp) { }
@@ -109,6 +243,7 @@ class BigSpaceAllocator {
         template <typename U>
         BigSpaceAllocator& operator=(const BigSpaceAllocator<U>& other) {
             sp_ = other.sp_;
+            return *this;
         };
 
         template <typename U>
@@ -119,16 +254,19 @@ class BigSpaceAllocator {
         template <typename U>
         BigSpaceAllocator& operator=(BigSpaceAllocator<U>&& other) noexcept {
             sp_ = other.sp_;
+            return *this;
         }
 
         T* allocate(size_t n) {
             return (T*)(sp_->allocate(n*sizeof(T)));
         }
-        void deallocate(T* data, size_t) {
-            sp_->deallocate(data);
+        void deallocate(T* data, size_t n) {
+            sp_->deallocate(data, n*sizeof(T));
         }
-        void deallocate(T* data) {
-            sp_->deallocate(data);
+
+        /** @brief Return the space allocations come from */
+        BigSpace& space() const {
+            return *sp_;
         }
 
         bool operator!=(const BigSpaceAllocator<T>& other) {
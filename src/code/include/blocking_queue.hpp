@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+namespace pando {
+
+/** @brief A bounded queue handing work from producer threads to consumers
+ *
+ * push blocks while the queue is full and pop blocks while it is empty.
+ * Once closed, pop returns the remaining items and then false.
+ */
+template <typename T>
+class BlockingQueue {
+    private:
+        deque<T> items_;
+        size_t capacity_;
+        bool closed_;
+
+        mutex mutex_;
+        condition_variable not_empty_;
+        condition_variable not_full_;
+
+    public:
+        BlockingQueue(size_t capacity) : capacity_(capacity), closed_(false) { }
+
+        /** @brief Add an item, waiting for room */
+        void push(T item) {
+            unique_lock lock(mutex_);
+            not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+            items_.push_back(move(item));
+            not_empty_.notify_one();
+        }
+
+        /** @brief Take the next item, waiting for one
+         *
+         * @return false once the queue is closed and empty
+         */
+        bool pop(T& item) {
+            unique_lock lock(mutex_);
+            not_empty_.wait(lock, [this]() { return !items_.empty() || closed_; });
+            if (items_.empty()) return false;
+            item = move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return true;
+        }
+
+        /** @brief Mark that no more items will be pushed */
+        void close() {
+            lock_guard lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+        }
+};
+
+}
@@ -2,6 +2,8 @@
 
 #include <unordered_set>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <cstdarg>
 
 #include <random>
@@ -9,34 +11,36 @@
 #include "types.h"
 #include "filter.hpp"
 #include "dbkey.h"
+#include "tag_dictionary.hpp"
+#include "absl/container/flat_hash_map.h"
 
 using namespace std;
 
 namespace pando {
 
+/** @brief Maps tag ids from another process's dictionary to this one's */
+using TagRemap = absl::flat_hash_map<tag_id_t, tag_id_t>;
+
 /** @brief Hold the database entries */
 template<typename Alloc=allocator<char>>
 class DBEntry {
     private:
         using Str = basic_string<char, char_traits<char>, Alloc>;
-        /** @brief A default allocator */
-        std::allocator<char> def_alloc_;
-
-        /** @brief Holds the allocator */
-        Alloc& alloc_;
 
-        /** @brief Hold the tags for the entry */
-        unordered_set<string> tags_;
+        /** @brief Hold the tags for the entry, as sorted TagDictionary ids */
+        vector<tag_id_t> tag_ids_;
 
-        /** @brief Hold the tags again as a c-string array */
+        /** @brief Hold the tags again as a c-string array, pointing into
+         * the TagDictionary */
         const char** c_tags_;
 
-        /** @brief Holds the value for the entry */
+        /** @brief Holds the value for the entry
+         *
+         * The value holds its own copy of the allocator, so moving an entry
+         * hands over the value's buffer instead of copying it
+         */
         Str value_;
 
-        /** @brief Holds a special empty string for terminating tag lists */
-        const string empty_string_;
-
         /** @brief Holds the key for the entry */
         dbkey_t key_;
 
@@ -48,7 +52,7 @@ class DBEntry {
             // First, delete all prior c_tags
             if (c_tags_ != nullptr) {
                 // Do not worry about freeing any internal strings, those are
-                // handled by tags_
+                // handled by the TagDictionary
                 // Remove the full tags container
                 delete [] c_tags_;
                 c_tags_ = nullptr;
@@ -56,61 +60,65 @@ class DBEntry {
             if (f) return;
 
             // Second, allocate new tags
-            size_t num_tags = tags_.size();
+            size_t num_tags = tag_ids_.size();
             // Allocate space for the number of tags + 1
             c_tags_ = new const char*[num_tags+1];
-            c_tags_[num_tags] = empty_string_.c_str();
+            c_tags_[num_tags] = "";
 
             // Assign the c strings for each tag
+            auto & dict = TagDictionary::get();
             size_t tag_ctr = 0;
-            for (const string & tag : tags_)
-                    c_tags_[tag_ctr++] = tag.c_str();
+            for (tag_id_t id : tag_ids_)
+                c_tags_[tag_ctr++] = dict.c_str(id);
+        }
+
+        /** @brief Add a tag id, keeping the ids sorted */
+        bool insert_tag_id_(tag_id_t id) {
+            auto it = lower_bound(tag_ids_.begin(), tag_ids_.end(), id);
+            if (it != tag_ids_.end() && *it == id) return false;
+            tag_ids_.insert(it, id);
+            return true;
         }
 
 
     public:
         /** @brief Construct a DB entry from C tags and values */
-        DBEntry(Alloc& alloc, const char* const* tags, const char* value) :
-                alloc_(alloc), c_tags_(nullptr), value_(alloc_), key_(INITIAL_KEY) {
+        DBEntry(const Alloc& alloc, const char* const* tags, const char* value) :
+                c_tags_(nullptr), value_(alloc), key_(INITIAL_KEY) {
             clear();
             while (*tags[0] != '\0')
-                tags_.insert(*tags++);
+                insert_tag_id_(TagDictionary::get().intern(*tags++));
             value_.assign(value);
             update_c_tags_();
         }
-        DBEntry(const char* const* tags, const char* value) : DBEntry(def_alloc_, tags, value) { }
+        DBEntry(const char* const* tags, const char* value) : DBEntry(Alloc(), tags, value) { }
 
         /** @brief Construct a DB entry from C tags, value, and key */
-        DBEntry(Alloc& alloc, const char* const* tags, const char* value, dbkey_t key) :
-                alloc_(alloc), c_tags_(nullptr), value_(alloc_), key_(key) {
+        DBEntry(const Alloc& alloc, const char* const* tags, const char* value, dbkey_t key) :
+                c_tags_(nullptr), value_(alloc), key_(key) {
             while (*tags[0] != '\0')
-                tags_.insert(*tags++);
+                insert_tag_id_(TagDictionary::get().intern(*tags++));
             value_.assign(value);
             update_c_tags_();
         }
-        DBEntry(const char* const* tags, const char* value, dbkey_t key) : DBEntry(def_alloc_, tags, value, key) { }
+        DBEntry(const char* const* tags, const char* value, dbkey_t key) : DBEntry(Alloc(), tags, value, key) { }
 
-        DBEntry(Alloc& alloc) : alloc_(alloc), c_tags_(nullptr), value_(alloc_), key_(INITIAL_KEY) { clear(); };
-        DBEntry() : DBEntry(def_alloc_) { }
+        DBEntry(const Alloc& alloc) : c_tags_(nullptr), value_(alloc), key_(INITIAL_KEY) { clear(); };
+        DBEntry() : DBEntry(Alloc()) { }
 
         ~DBEntry() { clear(true); }
 
         /** @brief Construct a DB entry from a move */
         DBEntry(DBEntry&& other) noexcept :
-                alloc_(other.alloc_),
-                tags_(move(other.tags_)),
+                tag_ids_(move(other.tag_ids_)),
                 c_tags_(other.c_tags_),
-                value_(alloc_),
+                value_(move(other.value_)),
                 key_(move(other.key_)) {
-            value_ = Str{alloc_};
-            value_.assign(other.value_);        // FIXME can we avoid copying?
+            // The C tags point into the TagDictionary, so they stay valid
 
             // Invalidate the other
             other.c_tags_ = nullptr;
             other.clear(true);
-
-            // Fix C tags if necessary
-            update_c_tags_();
         }
         /** @brief Move a DB entry */
         DBEntry& operator=(DBEntry&& other) noexcept {
@@ -118,17 +126,15 @@ class DBEntry {
             if (&other != this) {
                 clear(true);
 
-                alloc_ = move(other.alloc_);
-                tags_ = move(other.tags_);
+                tag_ids_ = move(other.tag_ids_);
                 c_tags_ = other.c_tags_;
-                value_ = Str{alloc_};
-                value_.assign(other.value_);        // FIXME can we avoid copying?
+                // The allocator moves with the value, so this takes over the
+                // other's buffer
+                value_ = move(other.value_);
                 key_ = move(other.key_);
 
                 other.c_tags_ = nullptr;
                 other.clear(true);
-
-                update_c_tags_();
             }
 
             return *this;
@@ -136,8 +142,7 @@ class DBEntry {
 
         /** @brief Construct a DB entry from a copy */
         DBEntry(const DBEntry& other) :
-                alloc_(other.alloc_),
-                tags_(other.tags_),
+                tag_ids_(other.tag_ids_),
                 c_tags_(nullptr),
                 value_(other.value_),
                 key_(INITIAL_KEY) {
@@ -147,8 +152,7 @@ class DBEntry {
         /** @brief Copy a DB entry */
         DBEntry& operator=(const DBEntry& other) {
             if (&other != this) {
-                alloc_ = other.alloc_;
-                tags_ = other.tags_;
+                tag_ids_ = other.tag_ids_;
                 value_ = other.value_;
 
                 key_ = INITIAL_KEY;
@@ -160,11 +164,23 @@ class DBEntry {
             return *this;
         }
 
+        /** @brief Copy the key, tags, and value of an entry that may use a
+         * different allocator, reusing this entry's storage */
+        template<typename OAlloc>
+        DBEntry& assign(const DBEntry<OAlloc>& other) {
+            tag_ids_ = other.tag_ids_;
+            value_.assign(other.value_.data(), other.value_.size());
+            key_ = other.key_;
+
+            update_c_tags_();
+            return *this;
+        }
+
         /** @brief Test if two DBEntry objects are not equal */
         bool operator!=(const DBEntry& other) {
             if (other.get_key() != get_key())
                 return true;
-            if (other.tags() != tags())
+            if (other.tag_ids_ != tag_ids_)
                 return true;
             if (other.value() != value())
                 return true;
@@ -195,9 +211,10 @@ class DBEntry {
             ser_size += value_size;
 
             ser_size += sizeof(size_t);
-            for (const string& tag : tags_) {
+            auto & dict = TagDictionary::get();
+            for (tag_id_t id : tag_ids_) {
                 ser_size += sizeof(size_t);
-                size_t tag_size = tag.size();
+                size_t tag_size = dict.tag(id).size();
                 ser_size += tag_size;
             }
 
@@ -214,17 +231,48 @@ class DBEntry {
             *(size_t*)ser_ptr = value_size; ser_ptr += sizeof(size_t);
             memcpy(ser_ptr, value_.c_str(), value_size); ser_ptr += value_size;
 
-            *(size_t*)ser_ptr = tags_.size(); ser_ptr += sizeof(size_t);
-            for (const string& tag : tags_) {
+            *(size_t*)ser_ptr = tag_ids_.size(); ser_ptr += sizeof(size_t);
+            auto & dict = TagDictionary::get();
+            for (tag_id_t id : tag_ids_) {
+                const string& tag = dict.tag(id);
                 size_t tag_size = tag.size();
                 *(size_t*)ser_ptr = tag_size; ser_ptr += sizeof(size_t);
                 memcpy(ser_ptr, tag.c_str(), tag_size); ser_ptr += tag_size;
             }
         }
 
+        /** @brief Compute the size required for compact serialization */
+        size_t serialize_compact_size() const {
+            // Format:
+            // <key>
+            // <size(value)>
+            // <value>
+            // <num(tags)>
+            // <foreach tag: <tag id>>
+            //
+            // The tag ids must be resolved with a dictionary sent alongside
+            return sizeof(dbkey_t) + sizeof(size_t) + value_.size()
+                + sizeof(size_t) + tag_ids_.size()*sizeof(tag_id_t);
+        }
+
+        /** @brief Place the compact serialized version of the object into an
+         * already-allocated memory location */
+        void serialize_compact(char*& ser_ptr) const {
+            size_t value_size = value_.size();
+
+            *(dbkey_t*)ser_ptr = key_; ser_ptr += sizeof(dbkey_t);
+            *(size_t*)ser_ptr = value_size; ser_ptr += sizeof(size_t);
+            memcpy(ser_ptr, value_.c_str(), value_size); ser_ptr += value_size;
+
+            size_t ntags = tag_ids_.size();
+            *(size_t*)ser_ptr = ntags; ser_ptr += sizeof(size_t);
+            memcpy(ser_ptr, tag_ids_.data(), ntags*sizeof(tag_id_t));
+            ser_ptr += ntags*sizeof(tag_id_t);
+        }
+
         /** @brief Initialize from serialized data */
-        DBEntry(Alloc& alloc, const char*& ser) :
-                alloc_(alloc), c_tags_(nullptr), value_(alloc), key_(INITIAL_KEY) {
+        DBEntry(const Alloc& alloc, const char*& ser) :
+                c_tags_(nullptr), value_(alloc), key_(INITIAL_KEY) {
             clear();
 
             // Copy out the key
@@ -235,16 +283,39 @@ class DBEntry {
             value_.assign(ser, ser+val_size); ser += val_size;
 
             size_t ntags = *(const size_t*)ser; ser += sizeof(size_t);
+            auto & dict = TagDictionary::get();
             for (; ntags > 0; --ntags) {
                 string tag;
                 size_t tag_size = *(const size_t*)ser; ser += sizeof(size_t);
                 tag.assign(ser, ser+tag_size); ser += tag_size;
-                tags_.insert(tag);
+                insert_tag_id_(dict.intern(tag));
+            }
+
+            update_c_tags_();
+        }
+        DBEntry(const char*& ser) : DBEntry(Alloc(), ser) { }
+
+        /** @brief Initialize from compact serialized data, translating the
+         * tag ids with remap */
+        DBEntry(const Alloc& alloc, const char*& ser, const TagRemap& remap) :
+                c_tags_(nullptr), value_(alloc), key_(INITIAL_KEY) {
+            clear();
+
+            key_ = *(const dbkey_t*)ser; ser += sizeof(dbkey_t);
+
+            size_t val_size = *(const size_t*)ser; ser += sizeof(size_t);
+            value_.assign(ser, ser+val_size); ser += val_size;
+
+            size_t ntags = *(const size_t*)ser; ser += sizeof(size_t);
+            for (; ntags > 0; --ntags) {
+                auto id = remap.find(*(const tag_id_t*)ser); ser += sizeof(tag_id_t);
+                if (id == remap.end()) throw runtime_error("Tag id missing from the dictionary");
+                insert_tag_id_(id->second);
             }
 
             update_c_tags_();
         }
-        DBEntry(const char*& ser) : DBEntry(def_alloc_, ser) { }
+        DBEntry(const char*& ser, const TagRemap& remap) : DBEntry(Alloc(), ser, remap) { }
 
         /** @brief Clear all memory in the entry
          *
@@ -256,7 +327,7 @@ class DBEntry {
          * @param f if true, remove all memory from the c_tags_, invaliding it
          */
         DBEntry& clear(bool f=false) {
-            tags_.clear();
+            tag_ids_.clear();
             value_.assign("");
 
             if (f)
@@ -277,8 +348,8 @@ class DBEntry {
         /** @brief Add a (potentially) new tag */
         DBEntry& add_tag(string tag) {
             if (c_tags_ == nullptr) throw runtime_error("Invalid DBEntry");
-            tags_.insert(tag);
-            update_c_tags_();
+            if (insert_tag_id_(TagDictionary::get().intern(tag)))
+                update_c_tags_();
             return *this;
         }
 
@@ -291,8 +362,12 @@ class DBEntry {
 
         /** @brief Remove a tag */
         DBEntry& remove_tag(string tag) {
-            tags_.erase(tag);
-            update_c_tags_();
+            tag_id_t id = TagDictionary::get().find(tag);
+            auto it = lower_bound(tag_ids_.begin(), tag_ids_.end(), id);
+            if (it != tag_ids_.end() && *it == id) {
+                tag_ids_.erase(it);
+                update_c_tags_();
+            }
             return *this;
         }
 
@@ -303,6 +378,20 @@ class DBEntry {
             return remove_tag(args...);
         }
 
+        /** @brief Add all of another entry's tags */
+        template<typename OAlloc>
+        DBEntry& merge_tags(const DBEntry<OAlloc>& other) {
+            if (c_tags_ == nullptr) throw runtime_error("Invalid DBEntry");
+            vector<tag_id_t> merged;
+            merged.reserve(tag_ids_.size() + other.tag_ids_.size());
+            set_union(tag_ids_.begin(), tag_ids_.end(),
+                other.tag_ids_.begin(), other.tag_ids_.end(),
+                back_inserter(merged));
+            tag_ids_.swap(merged);
+            update_c_tags_();
+            return *this;
+        }
+
         /** @brief Add more to the value string */
         DBEntry& add_to_value(const string& more) {
             if (c_tags_ == nullptr) throw runtime_error("Invalid DBEntry");
@@ -313,13 +402,18 @@ class DBEntry {
         /** @brief Return the number of tags */
         size_t tag_size() const {
             if (c_tags_ == nullptr) throw runtime_error("Invalid DBEntry");
-            return tags_.size();
+            return tag_ids_.size();
         }
 
         /** @brief Check whether a tag exists */
         bool has_tag(string check) const {
             if (c_tags_ == nullptr) throw runtime_error("Invalid DBEntry");
-            return tags_.count(check) > 0;
+            return has_tag_id(TagDictionary::get().find(check));
+        }
+
+        /** @brief Check whether a tag exists, by its TagDictionary id */
+        bool has_tag_id(tag_id_t id) const {
+            return binary_search(tag_ids_.begin(), tag_ids_.end(), id);
         }
 
         /** @brief Return the C-style tags
@@ -331,8 +425,26 @@ class DBEntry {
             return c_tags_;
         }
 
-        /** @brief Return the tags */
-        const unordered_set<string> & tags() const {return tags_;}
+        /** @brief Return a copy of the tags */
+        unordered_set<string> tags() const {
+            auto & dict = TagDictionary::get();
+            unordered_set<string> ret;
+            for (tag_id_t id : tag_ids_)
+                ret.insert(dict.tag(id));
+            return ret;
+        }
+
+        /** @brief Return the sorted TagDictionary ids of the tags */
+        const vector<tag_id_t>& tag_ids() const { return tag_ids_; }
+
+        /** @brief Replace the tags with the given TagDictionary ids */
+        DBEntry& set_tag_ids(vector<tag_id_t> ids) {
+            sort(ids.begin(), ids.end());
+            ids.erase(unique(ids.begin(), ids.end()), ids.end());
+            tag_ids_ = move(ids);
+            update_c_tags_();
+            return *this;
+        }
 
         /** @brief Return whether C-tags is valid */
         bool valid_c_tags() const { return c_tags_ != nullptr; }
@@ -354,7 +466,7 @@ class DBEntry {
         }
 
         /** @brief Return access function pointers to this entry */
-        DBAccess* access() {
+        DBAccess* access() const {
             if (c_tags_ == nullptr) throw runtime_error("Invalid DBEntry");
             DBAccess* ret = new DBAccess;
 
@@ -376,6 +488,9 @@ class DBEntry {
         /** @brief Return whether the key is random or not */
         bool random_key() const { return is_random_key(key_); }
 
+        template<typename OAlloc>
+        friend class DBEntry;
+
         template<typename OAlloc>
         friend ostream &operator<<(ostream &os, pando::DBEntry<OAlloc> const &entry);
 };
@@ -393,7 +508,7 @@ ostream &operator<<(ostream &os, DBEntry<Alloc> const &entry) {
     else
         os << entry.key_ << endl;
     os << "TAGS:" << endl;
-    for (auto & t : entry.tags_)
+    for (auto & t : entry.tags())
         os << t << endl;
     os << "VALUE:" << endl;
     os << entry.value();
@@ -43,6 +43,10 @@ typedef struct DBAccess {
     const char* value;
     /** Members specific for GROUP_ENTRIES filters */
     GroupAccess* group;
+    /** Look up several keys in one call, as
+     *  run(fn, size_t num_keys, const dbkey_t* keys, char** values)
+     * Each value is malloc'd, or NULL when the key does not exist */
+    fn get_entries_by_keys;
 } DBAccess;
 
 enum filter_type {
@@ -50,6 +54,22 @@ enum filter_type {
     GROUP_ENTRIES
 };
 
+/** @brief Describes, by tags and key, which entries a filter may run on
+ *
+ * For SINGLE_ENTRY filters, the database uses this with its tag index to find
+ * the candidate entries, and only calls should_run on those.  Tag lists are C-tags
+ * style (terminated by an empty string) and may be NULL.
+ */
+typedef struct FilterPredicate {
+    /** Candidates have all of these tags (NULL or empty for any entry) */
+    const char* const* required_tags;
+    /** Candidates have none of these tags */
+    const char* const* forbidden_tags;
+    /** Candidates have (key.a & key_a_mask) == key_a_value (mask 0 for any) */
+    chain_info_t key_a_mask;
+    chain_info_t key_a_value;
+} FilterPredicate;
+
 /** @brief Holds the tags and entry point for a filter */
 typedef struct FilterInterface {
     const char* filter_name;
@@ -58,6 +78,11 @@ typedef struct FilterInterface {
     void* (*init)(DBAccess*);
     void (*destroy)(void*);
     void (*run)(void*);
+    /** Optional; without one, should_run is called on every entry */
+    const FilterPredicate* predicate;
+    /** Set when should_run and run may be called from several threads at
+     * once, letting the database spread the filter's entries over threads */
+    bool thread_safe;
 } FilterInterface;
 
 }
@@ -146,6 +171,16 @@ class Filter {
             return i_->should_run(access);
         }
 
+        /** @brief Return the filter's predicate, or nullptr if it has none */
+        const FilterPredicate* predicate() {
+            return i_->predicate;
+        }
+
+        /** @brief Return whether the filter may run on several threads */
+        bool thread_safe() {
+            return i_->thread_safe;
+        }
+
         /** @brief Initialize a filter for running */
         void* init(DBAccess* access) {
             if (i_->init == nullptr) throw runtime_error("Filter does not support init");
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace pando {
+
+/** @brief How an entry added at the key of an existing entry is combined
+ * with it
+ *
+ * NONE keeps the default behavior: identical entries are dropped and
+ * different ones are concatenated.
+ */
+enum class MergeOp : uint8_t { NONE, SUM, MIN, MAX, COUNT, APPEND };
+
+/** @brief The prefix of the tags that choose an entry's merge operator */
+constexpr const char* MERGE_STRATEGY_PREFIX = "MERGE_STRATEGY=";
+
+/** @brief Return the merge operator named by a MERGE_STRATEGY= tag, or NONE */
+inline MergeOp merge_op_from_tag(const char* tag) {
+    size_t prefix_len = strlen(MERGE_STRATEGY_PREFIX);
+    if (strncmp(tag, MERGE_STRATEGY_PREFIX, prefix_len) != 0) return MergeOp::NONE;
+    string_view name {tag + prefix_len};
+    if (name == "SUM") return MergeOp::SUM;
+    if (name == "MIN") return MergeOp::MIN;
+    if (name == "MAX") return MergeOp::MAX;
+    if (name == "COUNT") return MergeOp::COUNT;
+    if (name == "APPEND") return MergeOp::APPEND;
+    return MergeOp::NONE;
+}
+
+/** @brief Return the tag added to entries merged with an operator */
+inline const char* merged_tag(MergeOp op) {
+    switch (op) {
+        case MergeOp::SUM: return "MERGED_SUM";
+        case MergeOp::MIN: return "MERGED_MIN";
+        case MergeOp::MAX: return "MERGED_MAX";
+        case MergeOp::COUNT: return "MERGED_COUNT";
+        default: return "MERGED";
+    }
+}
+
+/** @brief Whether applying the operator in any order gives the same value */
+inline bool merge_op_commutative(MergeOp op) {
+    return op == MergeOp::SUM || op == MergeOp::MIN || op == MergeOp::MAX || op == MergeOp::COUNT;
+}
+
+enum class ValueType : uint8_t { BYTES, INT64, DOUBLE };
+
+/** @brief An entry value read as a number, if it is one
+ *
+ * Whole numbers are kept as int64 so sums of counts stay exact, and other
+ * numbers as double.  Values are written back with the shortest text that
+ * reads back as the same number, so nothing is lost between merges.
+ */
+struct TypedValue {
+    ValueType type = ValueType::BYTES;
+    int64_t i = 0;
+    double d = 0;
+
+    TypedValue() = default;
+    explicit TypedValue(int64_t v) : type(ValueType::INT64), i(v) { }
+    explicit TypedValue(double v) : type(ValueType::DOUBLE), d(v) { }
+
+    /** @brief Read a value, which is BYTES unless it is all one number
+     * (surrounding whitespace aside) */
+    static TypedValue parse(string_view s) {
+        while (!s.empty() && isspace((unsigned char)s.front())) s.remove_prefix(1);
+        while (!s.empty() && isspace((unsigned char)s.back())) s.remove_suffix(1);
+        // from_chars takes no leading '+'
+        if (s.size() > 1 && s.front() == '+' && s[1] != '-') s.remove_prefix(1);
+        if (s.empty()) return {};
+
+        const char* first = s.data();
+        const char* last = first + s.size();
+        int64_t i;
+        auto [i_end, i_err] = from_chars(first, last, i);
+        if (i_err == errc() && i_end == last) return TypedValue {i};
+        double d;
+        auto [d_end, d_err] = from_chars(first, last, d);
+        if (d_err == errc() && d_end == last) return TypedValue {d};
+        return {};
+    }
+
+    bool is_number() const { return type != ValueType::BYTES; }
+
+    double as_double() const { return type == ValueType::INT64 ? (double)i : d; }
+
+    /** @brief Write the number as text */
+    string str() const {
+        char buf[32];
+        auto res = type == ValueType::INT64 ? to_chars(buf, buf+sizeof(buf), i) : to_chars(buf, buf+sizeof(buf), d);
+        return string(buf, res.ptr);
+    }
+};
+
+/** @brief Apply a numeric merge operator to two values
+ *
+ * @return false if either value is not a number, leaving out unchanged
+ */
+inline bool merge_numbers(MergeOp op, const TypedValue& a, const TypedValue& b, TypedValue& out) {
+    if (!a.is_number() || !b.is_number()) return false;
+    bool ints = a.type == ValueType::INT64 && b.type == ValueType::INT64;
+
+    switch (op) {
+        case MergeOp::SUM:
+        case MergeOp::COUNT: {
+            int64_t sum;
+            if (ints && !__builtin_add_overflow(a.i, b.i, &sum))
+                out = TypedValue {sum};
+            else
+                out = TypedValue {a.as_double() + b.as_double()};
+            return true;
+        }
+        case MergeOp::MIN:
+            if (ints) out = a.i <= b.i ? a : b;
+            else out = a.as_double() <= b.as_double() ? a : b;
+            return true;
+        case MergeOp::MAX:
+            if (ints) out = a.i >= b.i ? a : b;
+            else out = a.as_double() >= b.as_double() ? a : b;
+            return true;
+        default:
+            return false;
+    }
+}
+
+}
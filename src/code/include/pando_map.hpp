@@ -2,10 +2,13 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "dbentry.hpp"
+#include "pando_map_backend.hpp"
 #include "address.hpp"
 #include "par_db_participant.hpp"
 #include "pack.hpp"
 #include <thread>
+#include <mutex>
+#include <shared_mutex>
 #include <arpa/inet.h>
 #include <sstream>
 #include "big_space.hpp"
@@ -28,8 +31,49 @@ class PandoMap : public PandoParticipant {
         /** Socket for our pando map requests*/
         zmq_socket_t sock_map_;
 
-    public:
+        /** @brief Guard the map when it is also used in-process
+         *
+         * Requests served over ZMQ run on the map's own thread, while a
+         * PandoMapLocal modifies the map from the SeqDB thread
+         */
+        shared_mutex mutex_;
+
+        /** @brief Count modifications, so a saved scan position can be
+         * checked before it is resumed */
+        uint64_t version_ = 0;
+
+        /** @brief Where the most recent scan stopped */
+        absl::flat_hash_map<dbkey_t, DBEntry<Alloc>>::const_iterator scan_it_;
+        uint64_t scan_pos_ = PandoMapBackend::SCAN_DONE;
+        uint64_t scan_version_ = 0;
+
+        /** @brief Return an iterator to the pos-th entry of the map
+         *
+         * Resuming the previous scan is constant time; otherwise the map is
+         * walked from the start, which is correct as long as the map has not
+         * been modified since the scan began.
+         */
+        absl::flat_hash_map<dbkey_t, DBEntry<Alloc>>::const_iterator scan_position_(uint64_t pos) {
+            if (pos == scan_pos_ && version_ == scan_version_)
+                return scan_it_;
+
+            auto it = map_.cbegin();
+            for (uint64_t i = 0; i < pos && it != map_.cend(); ++i)
+                ++it;
+            return it;
+        }
+
+        /** @brief Return the entry at key to modify in place, which must
+         * exist */
+        DBEntry<Alloc>& modify_(dbkey_t key) {
+            auto it = map_.find(key);
+            if (it == map_.end())
+                throw runtime_error("Unable to find entry to modify");
+            ++version_;
+            return it->second;
+        }
 
+    public:
         PandoMap(const ZMQAddress &addr, size_t space_size) : PandoParticipant(addr, false), alloc_(make_shared<Space>(space_size)) {
             map_.reserve(1<<22);
         }
@@ -52,9 +96,69 @@ class PandoMap : public PandoParticipant {
         }
 
         void insert(DBEntry<Alloc> entry) {
+            ++version_;
             map_.insert_or_assign(entry.get_key(), move(entry));
         }
 
+        /** @brief Return the entry at key, or nullptr if it does not exist */
+        DBEntry<Alloc>* find(dbkey_t key) {
+            auto it = map_.find(key);
+            if (it == map_.end()) return nullptr;
+            return &(it->second);
+        }
+
+        /** @brief Copy an entry into the map, reusing the storage of any
+         * existing entry with the same key */
+        void assign(const DBEntry<>& entry) {
+            ++version_;
+            auto [it, inserted] = map_.try_emplace(entry.get_key(), alloc_);
+            (void)inserted;
+            it->second.assign(entry);
+        }
+
+        /** @brief Add tags to the stored entry at key */
+        void add_tags(dbkey_t key, const vector<string>& tags) {
+            auto & entry = modify_(key);
+            for (auto & tag : tags) entry.add_tag(tag);
+        }
+
+        /** @brief Remove tags from the stored entry at key */
+        void remove_tags(dbkey_t key, const vector<string>& tags) {
+            auto & entry = modify_(key);
+            for (auto & tag : tags) entry.remove_tag(tag);
+        }
+
+        /** @brief Replace the value of the stored entry at key, reusing its
+         * storage when the new value fits */
+        void set_value(dbkey_t key, const string& value) {
+            modify_(key).value().assign(value.data(), value.size());
+        }
+
+        /** @brief Apply a modification to the stored entry */
+        void modify(const MapModification& mod) {
+            auto & entry = modify_(mod.key);
+            if (mod.op == MapModification::ADD_TAG)
+                entry.add_tag(mod.arg);
+            else if (mod.op == MapModification::REMOVE_TAG)
+                entry.remove_tag(mod.arg);
+            else if (mod.op == MapModification::SET_VALUE)
+                entry.value().assign(mod.arg.data(), mod.arg.size());
+            else
+                throw runtime_error("Unknown map modification");
+        }
+
+        /** @brief Return the number of entries */
+        size_t size() const { return map_.size(); }
+
+        /** @brief Return the underlying map, for iterating in-process */
+        const absl::flat_hash_map<dbkey_t, DBEntry<Alloc>>& entries() const { return map_; }
+
+        /** @brief Lock the map for modification from another thread */
+        unique_lock<shared_mutex> write_lock() { return unique_lock<shared_mutex>(mutex_); }
+
+        /** @brief Lock the map for reading from another thread */
+        shared_lock<shared_mutex> read_lock() { return shared_lock<shared_mutex>(mutex_); }
+
         void recv_map_insert(zmq_socket_t sock, [[maybe_unused]] const char* data, [[maybe_unused]] const char* end) {
             insert({alloc_, data});
 
@@ -75,6 +179,63 @@ class PandoMap : public PandoParticipant {
 
         }
 
+        /** @brief Modify tags in place
+         *
+         * Request: <key> <num tags> <foreach tag: <size> <tag>>
+         */
+        void recv_map_modify_tags(msg_type_t type, zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            dbkey_t key;
+            size_t num_tags;
+            unpack_single(data, key);
+            unpack_single(data, num_tags);
+
+            vector<string> tags;
+            tags.reserve(num_tags);
+            for (size_t i = 0; i < num_tags; ++i) {
+                size_t tag_size;
+                unpack_single(data, tag_size);
+                tags.emplace_back(data, tag_size); data += tag_size;
+            }
+
+            if (type == MAP_ADD_TAGS)
+                add_tags(key, tags);
+            else
+                remove_tags(key, tags);
+
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ZMQChatterbox::ack(sock);
+        }
+
+        /** @brief Replace a value in place
+         *
+         * Request: <key> <size> <value>
+         */
+        void recv_map_set_value(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            dbkey_t key;
+            size_t value_size;
+            unpack_single(data, key);
+            unpack_single(data, value_size);
+
+            modify_(key).value().assign(data, value_size);
+
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ZMQChatterbox::ack(sock);
+        }
+
+        /** @brief Apply a batch of modifications in place
+         *
+         * Request: <num> <foreach: serialized MapModification>
+         */
+        void recv_map_modify_multiple(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            size_t num_mods;
+            unpack_single(data, num_mods);
+            for (size_t i = 0; i < num_mods; ++i)
+                modify(MapModification {data});
+
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ZMQChatterbox::ack(sock);
+        }
+
         void recv_map_retrieve(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
             dbkey_t key;
             unpack_single(data, key);
@@ -176,6 +337,52 @@ class PandoMap : public PandoParticipant {
             delete [] msg;
         }
 
+        /** @brief Return the next batch of a scan over all entries
+         *
+         * Request: <resume token> <max entries>, where a new scan starts at
+         * token 0.
+         * Response: <next resume token> <num entries> <entries>, where the
+         * next token is PandoMapBackend::SCAN_DONE once all entries have been returned.
+         */
+        void recv_map_scan_batch(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            uint64_t token;
+            size_t max_entries;
+            unpack_single(data, token);
+            unpack_single(data, max_entries);
+
+            auto begin = scan_position_(token);
+
+            // Find the size of the batch
+            size_t num_entries = 0;
+            size_t msg_size = sizeof(uint64_t)+sizeof(size_t);
+            auto it = begin;
+            for (; it != map_.cend() && num_entries < max_entries; ++it, ++num_entries)
+                msg_size += it->second.serialize_size();
+
+            // Remember where we stopped, so the next batch does not need to
+            // walk the map
+            uint64_t next_token = PandoMapBackend::SCAN_DONE;
+            if (it != map_.cend()) {
+                next_token = token+num_entries;
+                scan_it_ = it;
+                scan_pos_ = next_token;
+                scan_version_ = version_;
+            }
+
+            char* msg = new char[msg_size];
+            char *msg_ptr = msg;
+
+            pack_single(msg_ptr, next_token);
+            pack_single(msg_ptr, num_entries);
+            it = begin;
+            for (size_t i = 0; i < num_entries; ++i, ++it)
+                it->second.serialize(msg_ptr);
+
+            ZMQChatterbox::send(sock, msg, msg_size);
+
+            delete [] msg;
+        }
+
         void recv_map_does_key_exist(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
             dbkey_t key;
             unpack_single(data, key);
@@ -190,6 +397,17 @@ class PandoMap : public PandoParticipant {
         }
 
         void process_msg(msg_type_t type, zmq_socket_t sock, const char *data, const char* end) {
+            if (type == MAP_INSERT || type == MAP_INSERT_MULTIPLE || type == MAP_ADD_TAGS
+                    || type == MAP_REMOVE_TAGS || type == MAP_SET_VALUE || type == MAP_MODIFY_MULTIPLE) {
+                auto lock = write_lock();
+                process_map_msg(type, sock, data, end);
+            } else {
+                auto lock = read_lock();
+                process_map_msg(type, sock, data, end);
+            }
+        }
+
+        void process_map_msg(msg_type_t type, zmq_socket_t sock, const char *data, const char* end) {
             if (type == MAP_INSERT) 
                 recv_map_insert(sock, data, end);
             else if (type == MAP_INSERT_MULTIPLE)
@@ -206,6 +424,14 @@ class PandoMap : public PandoParticipant {
                 recv_map_get_entries(sock, data, end);
             else if (type == MAP_DOES_KEY_EXIST)
                 recv_map_does_key_exist(sock, data, end);
+            else if (type == MAP_SCAN_BATCH)
+                recv_map_scan_batch(sock, data, end);
+            else if (type == MAP_ADD_TAGS || type == MAP_REMOVE_TAGS)
+                recv_map_modify_tags(type, sock, data, end);
+            else if (type == MAP_SET_VALUE)
+                recv_map_set_value(sock, data, end);
+            else if (type == MAP_MODIFY_MULTIPLE)
+                recv_map_modify_multiple(sock, data, end);
             else
                 throw runtime_error("Unknown message type");
         }
@@ -215,25 +441,40 @@ class PandoMap : public PandoParticipant {
             return alloc_;
         }
 
-        DBEntry<Alloc> realloc_entry(DBEntry<> entry) {
-            DBEntry<Alloc> new_entry {alloc_};
-            new_entry.value().assign(entry.value());
-            new_entry.set_key(entry.get_key());
-            for (auto& tag : entry.tags()) {
-                new_entry.add_tag(tag);
+        /** @brief Return the space holding the entries' values */
+        const Space& space() const {
+            return alloc_.space();
+        }
+
+        /** @brief Copy every entry into a fresh space, giving back the
+         * memory left behind by replaced and resized values
+         *
+         * The old space is released once the last entry has moved, so the
+         * two spaces exist side-by-side for the duration.  The caller must
+         * hold the write lock.
+         */
+        void compact() {
+            ++version_;
+            Alloc alloc {make_shared<Space>(space().capacity())};
+            for (auto & [key, entry] : map_) {
+                DBEntry<Alloc> moved {alloc};
+                moved.assign(entry);
+                // The value's allocator moves with it, so the entry now
+                // lives in the new space
+                entry = move(moved);
             }
+            alloc_ = alloc;
+        }
 
+        DBEntry<Alloc> realloc_entry(const DBEntry<>& entry) {
+            DBEntry<Alloc> new_entry {alloc_};
+            new_entry.assign(entry);
             return new_entry;
         }
 
-        DBEntry<> realloc_entry(DBEntry<Alloc> entry) {
+        DBEntry<> realloc_entry(const DBEntry<Alloc>& entry) {
             DBEntry<> new_entry;
-            new_entry.value().assign(entry.value());
-            new_entry.set_key(entry.get_key());
-            for (auto& tag : entry.tags()) {
-                new_entry.add_tag(tag);
-            }
-
+            new_entry.assign(entry);
             return new_entry;
         }
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "dbentry.hpp"
+#include "pack.hpp"
+
+using namespace std;
+
+namespace pando {
+
+/** @brief A change to apply to an entry where it is stored */
+struct MapModification {
+    enum Op : uint8_t {
+        ADD_TAG,
+        REMOVE_TAG,
+        SET_VALUE
+    };
+
+    Op op;
+    dbkey_t key;
+    /** @brief The tag to add or remove, or the new value */
+    string arg;
+
+    MapModification(Op op, dbkey_t key, string arg) : op(op), key(key), arg(move(arg)) { }
+
+    /** @brief Deserialize a modification, advancing ser past it */
+    MapModification(const char*& ser) {
+        size_t arg_size;
+        elga::unpack_single(ser, op);
+        elga::unpack_single(ser, key);
+        elga::unpack_single(ser, arg_size);
+        arg.assign(ser, arg_size); ser += arg_size;
+    }
+
+    /** @brief Compute the size required for serialization */
+    size_t serialize_size() const {
+        // Format: <op> <key> <size(arg)> <arg>
+        return sizeof(Op)+sizeof(dbkey_t)+sizeof(size_t)+arg.size();
+    }
+
+    /** @brief Serialize into ser, advancing it */
+    void serialize(char*& ser) const {
+        elga::pack_single(ser, op);
+        elga::pack_single(ser, key);
+        elga::pack_single(ser, arg.size());
+        memcpy(ser, arg.data(), arg.size()); ser += arg.size();
+    }
+};
+
+/** @brief Interface to the storage holding a database's entries
+ *
+ * The SeqDB talks to its PandoMap only through this interface, so the map
+ * can either live behind a ZMQ socket (PandoMapClient) or be called
+ * directly in-process (PandoMapLocal).
+ */
+class PandoMapBackend {
+    public:
+        /** @brief The resume token returned once a batched scan has finished */
+        constexpr static uint64_t SCAN_DONE = ~0ull;
+
+        virtual ~PandoMapBackend() { }
+
+        /** @brief Return the number of stored entries */
+        virtual size_t size() = 0;
+
+        /** @brief Insert an entry, replacing any entry with the same key */
+        virtual void insert(DBEntry<> e) = 0;
+
+        /** @brief Insert many entries at once */
+        virtual void insert_multiple(absl::flat_hash_map<dbkey_t, DBEntry<>>* entries) = 0;
+
+        /** @brief Add tags to the entry at key, which must exist */
+        virtual void add_tags(dbkey_t key, const vector<string>& tags) = 0;
+
+        /** @brief Remove tags from the entry at key, which must exist */
+        virtual void remove_tags(dbkey_t key, const vector<string>& tags) = 0;
+
+        /** @brief Replace the value of the entry at key, which must exist */
+        virtual void set_value(dbkey_t key, const string& value) = 0;
+
+        /** @brief Apply many modifications at once, in order */
+        virtual void modify_multiple(const vector<MapModification>& mods) = 0;
+
+        /** @brief Return a copy of the entry at key and whether it exists */
+        virtual tuple<DBEntry<>, bool> retrieve_if_exists(dbkey_t key) = 0;
+
+        /** @brief Return a copy of the entry at key, which must exist */
+        virtual DBEntry<> retrieve(dbkey_t key) = 0;
+
+        /** @brief Return a copy of every entry */
+        virtual vector<DBEntry<>> retrieve_all_entries() = 0;
+
+        /** @brief Return whether an entry exists at key */
+        virtual bool key_exist(dbkey_t key) = 0;
+
+        /** @brief Return all stored keys */
+        virtual vector<dbkey_t> keys() = 0;
+
+        /** @brief Call f with a read-only view of the entry at key
+         *
+         * The view is only valid for the duration of the call.
+         *
+         * @return false if no entry exists at key
+         */
+        virtual bool visit(dbkey_t key, const function<void(const DBAccess&)>& f) = 0;
+
+        /** @brief Call f with a read-only view of every entry, until f
+         * returns false
+         *
+         * The map must not be modified during the scan.
+         */
+        virtual void scan(const function<bool(const DBAccess&)>& f) = 0;
+};
+
+}
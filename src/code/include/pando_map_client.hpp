@@ -2,18 +2,144 @@
 
 #include "util.hpp"
 #include "chatterbox.hpp"
+#include "pando_map_backend.hpp"
 
 using namespace std;
 using namespace elga;
 
 namespace pando {
 
-class PandoMapClient : public ZMQRequester {
+/** @brief Access a PandoMap running on its own thread over ZMQ */
+class PandoMapClient : public ZMQRequester, public PandoMapBackend {
     private:
+        /** @brief Our own address, used to open additional connections */
+        ZMQAddress myself_;
+
+        /** @brief Send a request to add or remove tags in place */
+        void send_modify_tags_(msg_type_t type, dbkey_t key, const vector<string>& tags) {
+            size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t)+sizeof(size_t);
+            for (auto & tag : tags)
+                msg_size += sizeof(size_t)+tag.size();
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, type);
+            pack_single(msg_ptr, key);
+            pack_single(msg_ptr, tags.size());
+            for (auto & tag : tags) {
+                pack_single(msg_ptr, tag.size());
+                pack_string(msg_ptr, tag);
+            }
+
+            send(msg, msg_size);
+
+            delete [] msg;
+
+            wait_ack();
+        }
+
     public:
-        using ZMQRequester::ZMQRequester;
+        /** @brief Number of entries fetched per round trip when scanning */
+        constexpr static size_t SCAN_BATCH_SIZE = 4096;
+
+        PandoMapClient(const ZMQAddress server, const ZMQAddress &myself) : ZMQRequester(server, myself), myself_(myself) { }
+
+        /** @brief Iterate over every entry of the map in batches
+         *
+         * Each round trip returns up to batch_size entries.  As soon as a
+         * batch arrives the next one is requested, so the map prepares it
+         * while the caller works through the current one.  The scan uses its
+         * own connection, leaving the client free for other requests (e.g.,
+         * lookups from filters) during the scan.
+         */
+        class Scan {
+            private:
+                ZMQRequester req_;
+                size_t batch_size_;
+
+                /** @brief Resume token of the outstanding request */
+                uint64_t token_;
+                bool pending_;
+
+                vector<DBEntry<>> batch_;
+                size_t pos_;
+
+                void request_() {
+                    size_t msg_size = sizeof(msg_type_t)+sizeof(uint64_t)+sizeof(size_t);
+                    char msg[msg_size];
+                    char* msg_ptr = msg;
+
+                    pack_msg(msg_ptr, MAP_SCAN_BATCH);
+                    pack_single(msg_ptr, token_);
+                    pack_single(msg_ptr, batch_size_);
+
+                    req_.send(msg, msg_size);
+                    pending_ = true;
+                }
+
+                void receive_() {
+                    ZMQMessage resp = req_.read();
+                    pending_ = false;
+                    const char *resp_data = resp.data();
+
+                    size_t num_entries;
+                    unpack_single(resp_data, token_);
+                    unpack_single(resp_data, num_entries);
+
+                    batch_.clear();
+                    batch_.reserve(num_entries);
+                    for (size_t i = 0; i < num_entries; ++i)
+                        batch_.emplace_back(resp_data);
+                    pos_ = 0;
+
+                    // Prefetch the next batch
+                    if (token_ != SCAN_DONE)
+                        request_();
+                }
+
+            public:
+                Scan(const ZMQAddress server, const ZMQAddress &myself, size_t batch_size=SCAN_BATCH_SIZE) :
+                        req_(server, myself), batch_size_(batch_size), token_(0), pending_(false), pos_(0) {
+                    request_();
+                }
+
+                ~Scan() {
+                    // Drain an unused prefetch before closing the connection
+                    if (pending_) req_.read();
+                }
+
+                /** @brief Return the next entry, or nullptr at the end */
+                DBEntry<>* next() {
+                    if (pos_ == batch_.size()) {
+                        if (!pending_) return nullptr;
+                        receive_();
+                        if (batch_.empty()) return nullptr;
+                    }
+                    return &batch_[pos_++];
+                }
+
+                class iterator {
+                    private:
+                        Scan* scan_;
+                        DBEntry<>* cur_;
+                    public:
+                        iterator(Scan* scan) : scan_(scan), cur_(scan ? scan->next() : nullptr) { }
+                        DBEntry<>& operator*() { return *cur_; }
+                        DBEntry<>* operator->() { return cur_; }
+                        iterator& operator++() { cur_ = scan_->next(); return *this; }
+                        bool operator!=(const iterator& other) const { return cur_ != other.cur_; }
+                };
+
+                iterator begin() { return iterator(this); }
+                iterator end() { return iterator(nullptr); }
+        };
+
+        /** @brief Start a batched scan over every entry */
+        Scan scan_entries(size_t batch_size=SCAN_BATCH_SIZE) {
+            return Scan(server_, myself_, batch_size);
+        }
 
-        size_t size() {
+        size_t size() override {
             send(MAP_SIZE);
             ZMQMessage resp = read();
             const char *resp_data = resp.data();
@@ -21,7 +147,7 @@ class PandoMapClient : public ZMQRequester {
             return ret;
         }
 
-        void insert(DBEntry<> e) {
+        void insert(DBEntry<> e) override {
             // Serialize the DB entry
             size_t msg_size = sizeof(msg_type_t)+e.serialize_size();
             char* msg = new char[msg_size];
@@ -41,7 +167,7 @@ class PandoMapClient : public ZMQRequester {
             wait_ack();
         }
 
-        void insert_multiple(absl::flat_hash_map<dbkey_t, DBEntry<>>* entries) {
+        void insert_multiple(absl::flat_hash_map<dbkey_t, DBEntry<>>* entries) override {
             size_t msg_size = sizeof(msg_type_t);
             for (auto & [key, entry] : *entries) {
                 msg_size += entry.serialize_size();
@@ -64,7 +190,53 @@ class PandoMapClient : public ZMQRequester {
             wait_ack();
         }
 
-        tuple<DBEntry<>, bool> retrieve_if_exists(dbkey_t key) {
+        void add_tags(dbkey_t key, const vector<string>& tags) override {
+            send_modify_tags_(MAP_ADD_TAGS, key, tags);
+        }
+
+        void remove_tags(dbkey_t key, const vector<string>& tags) override {
+            send_modify_tags_(MAP_REMOVE_TAGS, key, tags);
+        }
+
+        void set_value(dbkey_t key, const string& value) override {
+            size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t)+sizeof(size_t)+value.size();
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, MAP_SET_VALUE);
+            pack_single(msg_ptr, key);
+            pack_single(msg_ptr, value.size());
+            memcpy(msg_ptr, value.data(), value.size());
+
+            send(msg, msg_size);
+
+            delete [] msg;
+
+            wait_ack();
+        }
+
+        void modify_multiple(const vector<MapModification>& mods) override {
+            if (mods.empty()) return;
+
+            size_t msg_size = sizeof(msg_type_t)+sizeof(size_t);
+            for (auto & mod : mods)
+                msg_size += mod.serialize_size();
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, MAP_MODIFY_MULTIPLE);
+            pack_single(msg_ptr, mods.size());
+            for (auto & mod : mods)
+                mod.serialize(msg_ptr);
+
+            send(msg, msg_size);
+
+            delete [] msg;
+
+            wait_ack();
+        }
+
+        tuple<DBEntry<>, bool> retrieve_if_exists(dbkey_t key) override {
             // Serialize the key and tag
             size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t);
             char msg[msg_size];
@@ -93,7 +265,7 @@ class PandoMapClient : public ZMQRequester {
         }
 
 
-        DBEntry<> retrieve(dbkey_t key) {
+        DBEntry<> retrieve(dbkey_t key) override {
             // Serialize the key and tag
             size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t);
             char msg[msg_size];
@@ -113,7 +285,7 @@ class PandoMapClient : public ZMQRequester {
             return e;
         }
 
-        vector<DBEntry<>> retrieve_all_entries() {
+        vector<DBEntry<>> retrieve_all_entries() override {
             // Serialize the key and tag
             size_t msg_size = sizeof(msg_type_t);
             char msg[msg_size];
@@ -142,7 +314,7 @@ class PandoMapClient : public ZMQRequester {
             return entries;
         }
 
-        bool key_exist(dbkey_t key) {
+        bool key_exist(dbkey_t key) override {
             // Serialize the key and tag
             size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t);
             char msg[msg_size];
@@ -164,7 +336,7 @@ class PandoMapClient : public ZMQRequester {
             return exist;
         }
 
-        vector<dbkey_t> keys() {
+        vector<dbkey_t> keys() override {
             // Serialize the key and tag
             size_t msg_size = sizeof(msg_type_t);
             char msg[msg_size];
@@ -192,6 +364,26 @@ class PandoMapClient : public ZMQRequester {
             return keys;
         }
 
+        bool visit(dbkey_t key, const function<void(const DBAccess&)>& f) override {
+            auto [entry, exists] = retrieve_if_exists(key);
+            if (!exists) return false;
+
+            DBAccess* access = entry.access();
+            f(*access);
+            delete access;
+            return true;
+        }
+
+        void scan(const function<bool(const DBAccess&)>& f) override {
+            Scan entries = scan_entries();
+            for (auto & entry : entries) {
+                DBAccess* access = entry.access();
+                bool keep_going = f(*access);
+                delete access;
+                if (!keep_going) break;
+            }
+        }
+
 };
 
 }
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "pando_map.hpp"
+#include "pando_map_backend.hpp"
+
+using namespace std;
+
+namespace pando {
+
+/** @brief Access a PandoMap directly from the thread that owns the database
+ *
+ * This skips the serialize, send, and deserialize round-trip of the
+ * PandoMapClient.  The PandoMap may still serve ZMQ requests (e.g., for the
+ * PandoResponder) on its own thread; those only read, so modifications here
+ * take the map's write lock while reads, coming from the only writer, do not
+ * need to lock.
+ */
+class PandoMapLocal : public PandoMapBackend {
+    private:
+        /** @brief The map being accessed */
+        PandoMap& map_;
+
+    public:
+        PandoMapLocal(PandoMap& map) : map_(map) { }
+
+        size_t size() override {
+            return map_.size();
+        }
+
+        void insert(DBEntry<> e) override {
+            auto lock = map_.write_lock();
+            map_.assign(e);
+        }
+
+        void insert_multiple(absl::flat_hash_map<dbkey_t, DBEntry<>>* entries) override {
+            auto lock = map_.write_lock();
+            for (auto & [key, entry] : *entries) {
+                map_.assign(entry);
+            }
+        }
+
+        void add_tags(dbkey_t key, const vector<string>& tags) override {
+            auto lock = map_.write_lock();
+            map_.add_tags(key, tags);
+        }
+
+        void remove_tags(dbkey_t key, const vector<string>& tags) override {
+            auto lock = map_.write_lock();
+            map_.remove_tags(key, tags);
+        }
+
+        void set_value(dbkey_t key, const string& value) override {
+            auto lock = map_.write_lock();
+            map_.set_value(key, value);
+        }
+
+        void modify_multiple(const vector<MapModification>& mods) override {
+            auto lock = map_.write_lock();
+            for (auto & mod : mods)
+                map_.modify(mod);
+        }
+
+        tuple<DBEntry<>, bool> retrieve_if_exists(dbkey_t key) override {
+            auto entry = map_.find(key);
+            if (entry == nullptr) {
+                DBEntry e;
+                return {move(e), false};
+            }
+
+            DBEntry e;
+            e.assign(*entry);
+            return {move(e), true};
+        }
+
+        DBEntry<> retrieve(dbkey_t key) override {
+            auto entry = map_.find(key);
+            if (entry == nullptr)
+                throw runtime_error("Unable to find entry to retrieve");
+
+            DBEntry e;
+            e.assign(*entry);
+            return e;
+        }
+
+        vector<DBEntry<>> retrieve_all_entries() override {
+            vector<DBEntry<>> entries;
+            entries.reserve(map_.size());
+            for (auto & [key, entry] : map_.entries()) {
+                entries.push_back(map_.realloc_entry(entry));
+            }
+            return entries;
+        }
+
+        bool key_exist(dbkey_t key) override {
+            return map_.find(key) != nullptr;
+        }
+
+        vector<dbkey_t> keys() override {
+            vector<dbkey_t> keys;
+            keys.reserve(map_.size());
+            for (auto & [key, entry] : map_.entries()) {
+                keys.push_back(key);
+            }
+            return keys;
+        }
+
+        bool visit(dbkey_t key, const function<void(const DBAccess&)>& f) override {
+            auto entry = map_.find(key);
+            if (entry == nullptr) return false;
+
+            // The access points directly into the stored entry
+            DBAccess* access = entry->access();
+            f(*access);
+            delete access;
+            return true;
+        }
+
+        void scan(const function<bool(const DBAccess&)>& f) override {
+            for (auto & [key, entry] : map_.entries()) {
+                // The access points directly into the stored entry
+                DBAccess* access = entry.access();
+                bool keep_going = f(*access);
+                delete access;
+                if (!keep_going) break;
+            }
+        }
+};
+
+}
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <list>
+#include <map>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <thread>
 
+#include "absl/container/flat_hash_set.h"
+#include "blocking_queue.hpp"
 #include "terr.hpp"
 #include "pack.hpp"
 #include "chatterbox.hpp"
@@ -35,6 +40,7 @@ void s_ref_remove_tag(fn_ref, dbkey_t, string);
 void s_ref_update_entry_val(fn_ref, dbkey_t, string);
 void s_ref_subscribe_to_entry(fn_ref, dbkey_t, dbkey_t, string);
 void s_ref_get_entry_by_key(fn_ref, dbkey_t, char**);
+void s_ref_get_entries_by_keys(fn_ref, size_t, const dbkey_t*, char**);
 
 /** @brief Contains the parallel (distributed) database
  *
@@ -71,9 +77,85 @@ class ParDB : public PandoParticipant {
 
         bool skip_group_filters_ = false;
 
+        /** @brief Operations waiting to be sent to one agent as a MULTI_OP
+         * message */
+        struct Outbox {
+            vector<char> msg;
+            size_t num_ops = 0;
+        };
+        absl::flat_hash_map<addr_t, Outbox> outboxes_;
+
+        /** @brief Whether operations are held in the outboxes, rather than
+         * sent one message at a time */
+        bool batch_ops_ = false;
+
+        constexpr static size_t OUTBOX_MAX_OPS = 4096;
+        constexpr static size_t OUTBOX_MAX_BYTES = 1<<20;
+
+        /** @brief Remote lookups made during this stage's process, by key
+         *
+         * Entries only change when a stage closes, so a value (or its absence,
+         * held as nullopt) stays valid until then.
+         */
+        absl::flat_hash_map<dbkey_t, optional<string>> lookup_cache_;
+        size_t lookup_cache_bytes_ = 0;
+        size_t lookup_cache_hits_ = 0;
+        size_t lookup_cache_misses_ = 0;
+
+        constexpr static size_t LOOKUP_CACHE_MAX_BYTES = 64<<20;
+
+        /** @brief How often this agent has looked up each key, created on
+         * the first lookup */
+        unique_ptr<CountMinSketch> lookup_counts_;
+
+        /** @brief Hot keys this agent has asked the owners to replicate
+         *
+         * A request takes effect at the end of the stage it is made in, as
+         * the owner may not have it before then.
+         */
+        absl::flat_hash_set<dbkey_t> replicas_requested_;
+        absl::flat_hash_set<dbkey_t> replicated_keys_;
+
+        /** @brief Local copies of replicated keys' values (nullopt when
+         * missing), kept across stages until the owner reports a write */
+        absl::flat_hash_map<dbkey_t, optional<string>> replicas_;
+        size_t replicas_bytes_ = 0;
+
+        /** @brief For keys this agent owns, the agents replicating them */
+        absl::flat_hash_map<dbkey_t, vector<addr_t>> replica_holders_;
+
+        /** @brief Replicated keys written since the last barrier, reported
+         * to every agent as the barrier ends */
+        absl::flat_hash_set<dbkey_t> replica_writes_;
+        /** @brief Replicated keys with writes staged until the stage closes */
+        absl::flat_hash_set<dbkey_t> staged_replica_writes_;
+        /** @brief On the synchronizer, the writes reported at this barrier */
+        absl::flat_hash_set<dbkey_t> sync_replica_writes_;
+
+        /** @brief Lookups after which a key is replicated */
+        constexpr static int32_t HOT_KEY_LOOKUPS = 64;
+        constexpr static size_t MAX_REPLICATED_KEYS = 1<<16;
+        constexpr static size_t REPLICAS_MAX_BYTES = 64<<20;
+
+        /** @brief A query being returned a page at a time */
+        struct QueryCursor {
+            vector<dbkey_t> keys;
+            size_t pos = 0;
+            uint8_t fields;
+            size_t value_prefix;
+        };
+
+        /** @brief Open queries by cursor id, oldest first */
+        map<uint64_t, QueryCursor> query_cursors_;
+        uint64_t next_query_cursor_ = 1;
+
+        /** @brief Open queries kept before the oldest is dropped */
+        constexpr static size_t MAX_QUERY_CURSORS = 64;
+        constexpr static size_t QUERY_PAGE_MAX_BYTES = 16<<20;
+
     public:
         /** @brief Initialize the parallel DB */
-        ParDB(ZMQAddress addr, size_t sz, bool skip_group_filters=false) :
+        ParDB(ZMQAddress addr, size_t sz, bool skip_group_filters=false, bool ipc_map=false, double compact_threshold=0, size_t filter_threads=1, bool incremental=false) :
                 PandoParticipant(addr, true),
                 db_refs_(this,
                     s_ref_add_entry,
@@ -81,7 +163,8 @@ class ParDB : public PandoParticipant {
                     s_ref_remove_tag,
                     s_ref_update_entry_val,
                     s_ref_subscribe_to_entry,
-                    s_ref_get_entry_by_key
+                    s_ref_get_entry_by_key,
+                    s_ref_get_entries_by_keys
                 ),
                 db_(db_refs_, addr_ser_, sz),
                 state_(PRELOAD),
@@ -97,15 +180,22 @@ class ParDB : public PandoParticipant {
             sub(ADD_FILTER_DIR);
             sub(INSTALL_FILTER);
             sub(CLEAR_FILTERS);
+            sub(FULL_SCAN);
+            sub(SET_MERGE_STRATEGY);
             sub(EXPORT_DB);
 
             if (skip_group_filters_) db_.disable_group_filters();
+            if (ipc_map) db_.use_ipc_map(true);
+            db_.set_compact_threshold(compact_threshold);
+            db_.set_filter_threads(filter_threads);
+            db_.set_incremental(incremental);
         }
         ParDB(ZMQAddress addr) : ParDB(addr, 2ull*(1ull<<29)) { }
 
         /** @brief Send statistics as a custom heartbeat */
         virtual void custom_heartbeat() {
-            size_t msg_size = sizeof(msg_type_t)+sizeof(addr_t)+sizeof(size_t);
+            // <STATS> <addr> <db size> <lookup cache hits> <lookup cache misses>
+            size_t msg_size = sizeof(msg_type_t)+sizeof(addr_t)+3*sizeof(size_t);
             char msg[msg_size];
             char* msg_ptr = msg;
 
@@ -114,6 +204,8 @@ class ParDB : public PandoParticipant {
 
             size_t stat_size = db_size();
             pack_single(msg_ptr, stat_size);
+            pack_single(msg_ptr, lookup_cache_hits_);
+            pack_single(msg_ptr, lookup_cache_misses_);
 
             pub(msg, msg_size);
         }
@@ -154,6 +246,14 @@ class ParDB : public PandoParticipant {
                 recv_process_broadcast(sock, data, end);
             else if (type == QUERY)
                 recv_query(sock, data, end);
+            else if (type == QUERY_PAGE)
+                recv_query_page(sock, data, end);
+            else if (type == QUERY_NEXT)
+                recv_query_next(sock, data, end);
+            else if (type == QUERY_CLOSE)
+                recv_query_close(sock, data, end);
+            else if (type == AGGREGATE)
+                recv_aggregate(sock, data, end);
             else if (type == START_BARRIER_WAIT)
                 recv_start_barrier_wait(sock, data, end);
             else if (type == BARRIER_MSG_DIST)
@@ -172,6 +272,14 @@ class ParDB : public PandoParticipant {
                 recv_clear_filters_broadcast(sock, data, end);
             else if (type == CLEAR_FILTERS)
                 recv_clear_filters(sock, data, end);
+            else if (type == FULL_SCAN_BROADCAST)
+                recv_full_scan_broadcast(sock, data, end);
+            else if (type == FULL_SCAN)
+                recv_full_scan(sock, data, end);
+            else if (type == SET_MERGE_STRATEGY_BROADCAST)
+                recv_set_merge_strategy_broadcast(sock, data, end);
+            else if (type == SET_MERGE_STRATEGY)
+                recv_set_merge_strategy(sock, data, end);
             else if (type == EXPORT_DB)
                 recv_export_db(sock, data, end);
             else if (type == EXPORT_DB_BROADCAST)
@@ -180,6 +288,14 @@ class ParDB : public PandoParticipant {
                 recv_import_db(sock, data, end);
             else if (type == IMPORT_DB_DISTRIBUTE)
                 recv_import_db_distribute(sock, data, end);
+            else if (type == IMPORT_DB_ROUTED)
+                recv_import_db_routed(sock, data, end);
+            else if (type == ADD_ENTRIES_BULK)
+                recv_add_entries_bulk(sock, data, end);
+            else if (type == MULTI_OP)
+                recv_multi_op(sock, data, end);
+            else if (type == REPLICATE_KEY)
+                recv_replicate_key(sock, data, end);
             else if (type == GET_STATE)
                 recv_get_state(sock, data, end);
             else if (type == PRINT_ENTRIES)
@@ -195,124 +311,273 @@ class ParDB : public PandoParticipant {
             //Before we forward the entry, make sure it no longer has the INITIAL_KEY
             db_.verify_entry_key(&entry);
 
-            dbkey_t key = entry.get_key();
-
-            size_t ser_size = entry.serialize_size();
-            size_t msg_size = sizeof(msg_type_t)+ser_size;
-            char* msg = new char[msg_size];
-            char *msg_ptr = msg;
-
-            pack_msg(msg_ptr, ADD_ENTRY);
-            entry.serialize(msg_ptr);
-
-            // Get the requestor for the given DBKey
-            auto req = find_req(key);
-
-            req->send(msg, msg_size);
-
-            delete [] msg;
-
-            update_sent_dist(req->addr());
+            send_op_(entry.get_key(), ADD_ENTRY, entry.serialize_size(),
+                    [&](char*& msg_ptr) { entry.serialize(msg_ptr); });
         }
 
         /** @brief Add a tag to an existing entry */
         void add_tag_to_entry(dbkey_t key, string tag) {
-            // Serialize the key and tag
-            size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t)+tag.size();
-            char* msg = new char[msg_size];
-            char* msg_ptr = msg;
+            send_key_and_string_(key, ADD_TAG_TO_ENTRY, tag);
+        }
 
-            pack_msg(msg_ptr, ADD_TAG_TO_ENTRY);
+        /** @brief Remove a tag from an entry */
+        void remove_tag_from_entry(dbkey_t key, string tag) {
+            send_key_and_string_(key, REMOVE_TAG_FROM_ENTRY, tag);
+        }
 
-            // Add the actual entry
-            pack_single(msg_ptr, key);
-            pack_string(msg_ptr, tag);
+        /** @brief Update the value of an entry */
+        void update_entry_val(dbkey_t key, string tag) {
+            send_key_and_string_(key, UPDATE_ENTRY_VAL, tag);
+        }
 
-            // Send it to the ParDB
+        /** @brief Subscribe to an entry (wait for it to be created) */
+        void subscribe_to_entry(dbkey_t my_key, dbkey_t wait_key, string inactive_tag) {
+            send_op_(wait_key, SUBSCRIBE_TO_ENTRY, sizeof(dbkey_t)+sizeof(dbkey_t)+inactive_tag.size(),
+                    [&](char*& msg_ptr) {
+                        pack_single(msg_ptr, my_key);
+                        pack_single(msg_ptr, wait_key);
+                        pack_string(msg_ptr, inactive_tag);
+                    });
+        }
+
+        void send_key_and_string_(dbkey_t key, msg_type_t type, const string& str) {
+            send_op_(key, type, sizeof(dbkey_t)+str.size(),
+                    [&](char*& msg_ptr) {
+                        pack_single(msg_ptr, key);
+                        pack_string(msg_ptr, str);
+                    });
+        }
+
+        /** @brief Send an operation to the owner of a key
+         *
+         * While batch_ops_ is set, the operation is appended to the owner's
+         * outbox, which is sent as one MULTI_OP message once it is full or
+         * flush_outboxes is called.  Otherwise it is sent as its own message.
+         * Either way, it counts as one message for the barrier.
+         *
+         * @param pack writes the operation's payload_size bytes
+         */
+        template <typename Pack>
+        void send_op_(dbkey_t key, msg_type_t type, size_t payload_size, Pack pack) {
             auto req = find_req(key);
-            req->send(msg, msg_size);
+            addr_t agent = req->addr();
 
-            delete [] msg;
+            if (!batch_ops_) {
+                size_t msg_size = sizeof(msg_type_t)+payload_size;
+                char* msg = new char[msg_size];
+                char* msg_ptr = msg;
 
-            update_sent_dist(req->addr());
-        }
+                pack_msg(msg_ptr, type);
+                pack(msg_ptr);
 
-        /** @brief Remove a tag from an entry */
-        void remove_tag_from_entry(dbkey_t key, string tag) {
-            // Serialize the key and tag
-            size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t)+tag.size();
-            char* msg = new char[msg_size];
-            char* msg_ptr = msg;
+                req->send(msg, msg_size);
+
+                delete [] msg;
+            } else {
+                // Format:
+                // <MULTI_OP>
+                // <foreach op:
+                //      <size(type + payload)>
+                //      <type>
+                //      <payload>
+                // >
+                auto & box = outboxes_[agent];
+                if (box.msg.empty())
+                    box.msg.resize(sizeof(msg_type_t));
+                size_t pos = box.msg.size();
+                box.msg.resize(pos+sizeof(size_t)+sizeof(msg_type_t)+payload_size);
+
+                char* msg_ptr = box.msg.data()+pos;
+                pack_single(msg_ptr, sizeof(msg_type_t)+payload_size);
+                pack_msg(msg_ptr, type);
+                pack(msg_ptr);
+
+                if (++box.num_ops == OUTBOX_MAX_OPS || box.msg.size() >= OUTBOX_MAX_BYTES)
+                    flush_outbox_(agent, box);
+            }
 
-            pack_msg(msg_ptr, REMOVE_TAG_FROM_ENTRY);
+            update_sent_dist(agent);
+        }
 
-            // Add the actual entry
-            pack_single(msg_ptr, key);
-            pack_string(msg_ptr, tag);
+        void flush_outbox_(addr_t agent, Outbox& box) {
+            if (box.num_ops == 0) return;
 
-            // Send it to the ParDB
-            auto req = find_req(key);
-            req->send(msg, msg_size);
+            char* msg_ptr = box.msg.data();
+            pack_msg(msg_ptr, MULTI_OP);
 
-            delete [] msg;
+            get_req(agent)->send(box.msg.data(), box.msg.size());
 
-            update_sent_dist(req->addr());
+            box.msg.clear();
+            box.num_ops = 0;
         }
 
-        /** @brief Update the value of an entry */
-        void update_entry_val(dbkey_t key, string tag) {
-            // Serialize the key and tag
-            size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t)+tag.size();
-            char* msg = new char[msg_size];
-            char* msg_ptr = msg;
+        /** @brief Send every held operation, and stop holding them */
+        void flush_outboxes() {
+            for (auto & [agent, box] : outboxes_)
+                flush_outbox_(agent, box);
+            batch_ops_ = false;
+        }
 
-            pack_msg(msg_ptr, UPDATE_ENTRY_VAL);
+        /** @brief Apply each operation of a MULTI_OP message in order */
+        void recv_multi_op(zmq_socket_t sock, const char* data, const char* end) {
+            while (data < end) {
+                size_t op_size;
+                unpack_single(data, op_size);
+                const char* op_end = data+op_size;
 
-            // Add the actual entry
-            pack_single(msg_ptr, key);
-            pack_string(msg_ptr, tag);
+                msg_type_t type = unpack_msg(data);
+                // Each op looks like a full message of its own, so handlers
+                // can still forward it with get_full_msg
+                process_msg(type, NULL, data, op_end);
 
-            // Send it to the ParDB
-            auto req = find_req(key);
-            req->send(msg, msg_size);
+                data = op_end;
+            }
 
-            delete [] msg;
+            // If necessary, respond with an acknowledgement
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
 
-            update_sent_dist(req->addr());
+        /** @brief Read one <size, or NOT_FOUND> <value> from a lookup reply */
+        static optional<string> unpack_lookup_(const char*& data) {
+            size_t value_size;
+            unpack_single(data, value_size);
+            if (value_size == PandoResponder::NOT_FOUND) return nullopt;
+            string value {data, value_size};
+            data += value_size;
+            return value;
         }
 
-        /** @brief Subscribe to an entry (wait for it to be created) */
-        void subscribe_to_entry(dbkey_t my_key, dbkey_t wait_key, string inactive_tag) {
-            // Serialize the key and tag
-            size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t)+sizeof(dbkey_t)+inactive_tag.size();
-            char* msg = new char[msg_size];
-            char* msg_ptr = msg;
+        /** @brief Return a malloc'd, NULL-terminated copy of a value, as
+         * handed to filters */
+        static char* copy_value_(const string& value) {
+            char* res = (char*)malloc(value.size()+1);
+            if (res == nullptr) throw runtime_error("Unable to allocate memory");
+            memcpy(res, value.data(), value.size());
+            res[value.size()] = '\0';
+            return res;
+        }
 
-            pack_msg(msg_ptr, SUBSCRIBE_TO_ENTRY);
+        /** @brief Answer a lookup from a replica or this stage's cache
+         *
+         * Also counts the lookup, asking the owner to replicate the key once
+         * it is hot.
+         *
+         * @return whether the lookup was answered
+         */
+        bool lookup_local_(dbkey_t key, char** res) {
+            if (state_ == STAGE_BEGIN) count_lookup_(key);
+
+            const optional<string>* value = nullptr;
+            if (auto replica = replicas_.find(key); replica != replicas_.end())
+                value = &replica->second;
+            else if (auto cached = lookup_cache_.find(key); cached != lookup_cache_.end())
+                value = &cached->second;
+
+            if (value == nullptr) {
+                ++lookup_cache_misses_;
+                return false;
+            }
+            ++lookup_cache_hits_;
+            if (*value) *res = copy_value_(**value);
+            return true;
+        }
+
+        /** @brief Count a lookup, and request a replica of hot keys */
+        void count_lookup_(dbkey_t key) {
+            if (!lookup_counts_) lookup_counts_ = make_unique<CountMinSketch>();
+            if (lookup_counts_->query_count(hash<dbkey_t>{}(key)) < HOT_KEY_LOOKUPS) return;
+            if (replicated_keys_.contains(key) || replicas_requested_.contains(key)) return;
+            if (replicated_keys_.size()+replicas_requested_.size() >= MAX_REPLICATED_KEYS) return;
+
+            replicas_requested_.insert(key);
+            send_op_(key, REPLICATE_KEY, sizeof(dbkey_t)+sizeof(addr_t),
+                    [&](char*& msg_ptr) {
+                        pack_single(msg_ptr, key);
+                        pack_single(msg_ptr, addr_ser_);
+                    });
+        }
+
+        /** @brief Remember a lookup until the stage closes, or for replicated
+         * keys, until the owner reports a write
+         *
+         * Only lookups made while processing are kept, and new keys are
+         * dropped once the cache reaches LOOKUP_CACHE_MAX_BYTES.
+         */
+        void cache_lookup_(dbkey_t key, optional<string> value) {
+            if (state_ != STAGE_BEGIN) return;
+            size_t bytes = sizeof(dbkey_t)+sizeof(optional<string>)+(value ? value->size() : 0);
+            if (replicated_keys_.contains(key)) {
+                if (replicas_bytes_+bytes > REPLICAS_MAX_BYTES) return;
+                if (replicas_.try_emplace(key, move(value)).second)
+                    replicas_bytes_ += bytes;
+                return;
+            }
+            if (lookup_cache_bytes_+bytes > LOOKUP_CACHE_MAX_BYTES) return;
+            if (lookup_cache_.try_emplace(key, move(value)).second)
+                lookup_cache_bytes_ += bytes;
+        }
 
-            // Add the actual entry
-            pack_single(msg_ptr, my_key);
-            pack_single(msg_ptr, wait_key);
-            pack_string(msg_ptr, inactive_tag);
+        /** @brief Forget all cached lookups */
+        void clear_lookup_cache_() {
+            lookup_cache_.clear();
+            lookup_cache_bytes_ = 0;
+        }
 
-            // Send it to the ParDB
-            auto req = find_req(wait_key);
-            req->send(msg, msg_size);
+        /** @brief Record that an agent replicates a key we own
+         *
+         * <key> <agent>
+         */
+        void recv_replicate_key(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            dbkey_t key;
+            addr_t holder;
+            unpack_single(data, key);
+            unpack_single(data, holder);
+            update_recv_dist();
 
-            delete [] msg;
+            auto & holders = replica_holders_[key];
+            if (std::find(holders.begin(), holders.end(), holder) == holders.end())
+                holders.push_back(holder);
+
+            // If necessary, respond with an acknowledgement
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
 
-            update_sent_dist(req->addr());
+        /** @brief Note a write to a key we own, should it be replicated */
+        void note_replica_write_(dbkey_t key) {
+            if (!replica_holders_.contains(key)) return;
+            if (state_ == STAGE_CLOSING || state_ == PRELOAD)
+                replica_writes_.insert(key);
+            else
+                staged_replica_writes_.insert(key);
         }
 
+        /** @brief Note writes to every replicated key we own, e.g., after
+         * loading a file */
+        void note_all_replicas_written_() {
+            for (auto & [key, holders] : replica_holders_)
+                replica_writes_.insert(key);
+        }
+
+        void drop_replica_(dbkey_t key) {
+            auto replica = replicas_.find(key);
+            if (replica == replicas_.end()) return;
+            replicas_bytes_ -= sizeof(dbkey_t)+sizeof(optional<string>)+(replica->second ? replica->second->size() : 0);
+            replicas_.erase(replica);
+        }
 
         /** @brief Lookup an entry by key */
         void get_entry_by_key(dbkey_t key, char** res) {
+            *res = nullptr;
+            if (lookup_local_(key, res)) return;
+
             // Serialize the key and tag
             size_t msg_size = sizeof(msg_type_t)+sizeof(dbkey_t);
             char msg[msg_size];
             char* msg_ptr = msg;
 
-            pack_msg(msg_ptr, GET_ENTRY_BY_KEY);
+            pack_msg(msg_ptr, GET_ENTRIES_BY_KEYS);
 
             // Pack the key into the message
             pack_single(msg_ptr, key);
@@ -323,17 +588,50 @@ class ParDB : public PandoParticipant {
 
             ZMQMessage resp = req->read();
             const char *data = resp.data();
-            const char *end = resp.end();
-            string value { data, end };
+            optional<string> value = unpack_lookup_(data);
+            if (value) *res = copy_value_(*value);
+            cache_lookup_(key, move(value));
+        }
+
+        /** @brief Lookup several entries by key
+         *
+         * The keys are grouped by the agent that owns them, and each owner's
+         * responder is sent one request for all of its keys.  Every request
+         * is sent before any reply is read, so the lookups overlap.
+         */
+        void get_entries_by_keys(size_t num_keys, const dbkey_t* keys, char** res) {
+            // Serialize: <GET_ENTRIES_BY_KEYS> <foreach key: <key>>
+            absl::flat_hash_map<addr_t, vector<size_t>> by_owner;
+            for (size_t i = 0; i < num_keys; ++i) {
+                res[i] = nullptr;
+                if (lookup_local_(keys[i], &res[i])) continue;
+                by_owner[lookup_agent(keys[i])].push_back(i);
+            }
 
-            if (value == "\0") {
-                //entry was not found, we want the result to be a nullptr
-                res = nullptr;
-                return;
+            vector<pair<ZMQRequester*, const vector<size_t>*>> pending;
+            pending.reserve(by_owner.size());
+            for (auto & [owner, indices] : by_owner) {
+                vector<char> msg(sizeof(msg_type_t)+indices.size()*sizeof(dbkey_t));
+                char* msg_ptr = msg.data();
+                pack_msg(msg_ptr, GET_ENTRIES_BY_KEYS);
+                for (size_t i : indices)
+                    pack_single(msg_ptr, keys[i]);
+
+                auto req = find_req(keys[indices.front()], true);
+                req->send(msg.data(), msg.size());
+                pending.emplace_back(&*req, &indices);
+            }
+
+            // Each reply is <foreach key: <size, or NOT_FOUND> <value>>
+            for (auto & [req, indices] : pending) {
+                ZMQMessage resp = req->read();
+                const char* data = resp.data();
+                for (size_t i : *indices) {
+                    optional<string> value = unpack_lookup_(data);
+                    if (value) res[i] = copy_value_(*value);
+                    cache_lookup_(keys[i], move(value));
+                }
             }
-            *res = (char*)malloc(sizeof(char)*value.size()+1); // add one for the null terminator
-            if (*res == nullptr) throw runtime_error("Unable to allocate memory");
-            strcpy(*res, value.c_str());
         }
 
         /** @brief Broadcast the message to add a filter directory to the internal DB */
@@ -458,6 +756,65 @@ class ParDB : public PandoParticipant {
             db_.clear_filters();
         }
 
+        /** @brief Have every DB check all of its entries in the next stage */
+        void recv_full_scan_broadcast(zmq_socket_t sock, [[maybe_unused]] const char* data, [[maybe_unused]] const char* end) {
+            msg_type_t msg = FULL_SCAN;
+            pub((char*)&msg, sizeof(msg));
+
+            //also send to self
+            auto req = get_req(addr_.serialize());
+            req->send(FULL_SCAN);
+
+            // If necessary, respond with an acknowledgement
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
+
+        /** @brief Check all entries in the next stage, even when incremental */
+        void recv_full_scan(zmq_socket_t sock, [[maybe_unused]] const char* data, [[maybe_unused]] const char* end) {
+            db_.request_full_scan();
+
+            // If necessary, respond with an acknowledgement
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
+
+        /** @brief Set a key family's merge strategy and tell all neighbors
+         * to do the same */
+        void recv_set_merge_strategy_broadcast(zmq_socket_t sock, const char* data, const char* end) {
+            recv_set_merge_strategy(NULL, data, end);
+
+            size_t msg_size = sizeof(msg_type_t) + (end - data);
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, SET_MERGE_STRATEGY);
+            memcpy(msg_ptr, data, end - data);
+
+            // Send it to all neighbors
+            pub(msg, msg_size);
+
+            delete [] msg;
+
+            // If necessary, respond with an acknowledgement
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
+
+        /** @brief Set a key family's merge strategy in the internal DB */
+        void recv_set_merge_strategy(zmq_socket_t sock, const char* data, const char* end) {
+            // <key_a_mask><key_a_value><strategy tag>
+            auto key_a_mask = unpack_single<chain_info_t>(data);
+            auto key_a_value = unpack_single<chain_info_t>(data);
+            string strategy {data, end};
+
+            db_.set_merge_strategy(key_a_mask, key_a_value, strategy);
+
+            // If necessary, respond with an acknowledgement
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
+
         /** @brief Return a list of all entries*/
         void recv_get_entries(zmq_socket_t sock, [[maybe_unused]]const char* data, [[maybe_unused]]const char* end) {
             auto entries = db_.entries();
@@ -532,7 +889,6 @@ class ParDB : public PandoParticipant {
             } else {
                 for (const auto & entry : std::filesystem::directory_iterator(dir)) {
                     if (entry.is_directory()) continue;
-                    auto& n_req = *n_it;
 
                     string full_fn = entry.path().string();
 
@@ -543,14 +899,21 @@ class ParDB : public PandoParticipant {
                     pack_msg(msg_ptr, IMPORT_DB);
                     pack_string(msg_ptr, full_fn);
 
-                    n_req.send(msg, msg_size);
+                    if (Snapshot::is_snapshot(full_fn)) {
+                        // Every agent loads the entries it owns under the
+                        // current ring straight from the file
+                        for (auto & n_req : neighbors)
+                            n_req.send(msg, msg_size);
+                    } else {
+                        n_it->send(msg, msg_size);
+
+                        // Move to the next neighbor
+                        ++n_it;
+                        if (n_it == neighbors.end())
+                            n_it = neighbors.begin();
+                    }
 
                     delete [] msg;
-
-                    // Move to the next neighbor
-                    ++n_it;
-                    if (n_it == neighbors.end())
-                        n_it = neighbors.begin();
                 }
             }
 
@@ -569,9 +932,142 @@ class ParDB : public PandoParticipant {
             string suffix = ".txt";
             if (suffix == fn.substr(fn.length() - suffix.length(), fn.length())) {
                 db_.add_db_file(fn);
+            } else if (Snapshot::is_snapshot(fn)) {
+                // Load only our own entries; the other agents load theirs
+                db_.import_db(fn, [this](dbkey_t key) { return has_ownership(key); });
             } else {
                 db_.import_db(fn);
             }
+            note_all_replicas_written_();
+        }
+
+        /** @brief Entries per ADD_ENTRIES_BULK message on a routed import */
+        constexpr static size_t ROUTED_BATCH_SIZE = 4096;
+        /** @brief Batches the reader may get ahead of the sender */
+        constexpr static size_t ROUTED_QUEUE_DEPTH = 16;
+
+        void recv_import_db_routed(zmq_socket_t sock, const char* data, const char* end) {
+            string path {data, end};
+
+            import_db_routed(path);
+
+            // If necessary, respond with an acknowledgement
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
+
+        /** @brief Import snapshots, sending each entry straight to its owner
+         *
+         * Unlike IMPORT_DB_DISTRIBUTE, only this agent reads the files.  A
+         * reader thread builds the entries and groups them by owner under
+         * the current ring, while this thread sends each full group as one
+         * ADD_ENTRIES_BULK message.  Files that are not snapshots are
+         * imported as with import_db.
+         *
+         * @param path a snapshot file, or a directory of exported files
+         */
+        void import_db_routed(string path) {
+            vector<string> snapshots, others;
+            if (std::filesystem::is_directory(path)) {
+                for (const auto & entry : std::filesystem::directory_iterator(path)) {
+                    if (entry.is_directory()) continue;
+                    string fn = entry.path().string();
+                    (Snapshot::is_snapshot(fn) ? snapshots : others).push_back(fn);
+                }
+            } else if (Snapshot::is_snapshot(path)) {
+                snapshots.push_back(path);
+            } else {
+                others.push_back(path);
+            }
+
+            BlockingQueue<pair<addr_t, vector<DBEntry<>>>> batches {ROUTED_QUEUE_DEPTH};
+            exception_ptr reader_error;
+            thread reader([&]() {
+                try {
+                    absl::flat_hash_map<addr_t, vector<DBEntry<>>> pending;
+                    for (auto & fn : snapshots) {
+                        Snapshot snap {fn};
+                        for (size_t i = 0; i < snap.size(); ++i) {
+                            addr_t owner = lookup_agent(snap.key(i));
+                            auto & batch = pending[owner];
+                            batch.push_back(snap.entry(i));
+                            if (batch.size() == ROUTED_BATCH_SIZE) {
+                                batches.push({owner, move(batch)});
+                                batch.clear();
+                            }
+                        }
+                    }
+                    for (auto & [owner, batch] : pending) {
+                        if (!batch.empty())
+                            batches.push({owner, move(batch)});
+                    }
+                } catch (...) {
+                    reader_error = current_exception();
+                }
+                batches.close();
+            });
+
+            pair<addr_t, vector<DBEntry<>>> batch;
+            while (batches.pop(batch)) {
+                if (batch.first == addr_ser_)
+                    add_entries_bulk_(move(batch.second));
+                else
+                    send_entries_bulk_(batch.first, batch.second);
+            }
+            reader.join();
+            if (reader_error) rethrow_exception(reader_error);
+
+            for (auto & fn : others)
+                import_db(fn);
+        }
+
+        /** @brief Send a batch of entries to the agent that owns them */
+        void send_entries_bulk_(addr_t agent, const vector<DBEntry<>>& entries) {
+            size_t msg_size = sizeof(msg_type_t)+SeqDB::serialize_size(entries);
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, ADD_ENTRIES_BULK);
+            SeqDB::serialize_entries(msg_ptr, entries);
+
+            auto req = get_req(agent);
+            req->send(msg, msg_size);
+
+            delete [] msg;
+
+            update_sent_dist(agent);
+        }
+
+        /** @brief Insert a batch of entries from a routed import */
+        void recv_add_entries_bulk(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            update_recv_dist();
+
+            add_entries_bulk_(SeqDB::deserialize_entries(data));
+
+            // If necessary, respond with an acknowledgement
+            if (ZMQRequester::is_reqrep_sock(sock))
+                ack(sock);
+        }
+
+        /** @brief Add entries routed to this agent
+         *
+         * Should the ring have changed since the batch was routed, entries
+         * that are no longer ours are forwarded one at a time.
+         */
+        void add_entries_bulk_(vector<DBEntry<>> entries) {
+            for (auto & e : entries) {
+                if (!has_ownership(e.get_key())) {
+                    add_entry(move(e));
+                    continue;
+                }
+
+                note_replica_write_(e.get_key());
+                if (state_ == STAGE_CLOSING || state_ == PRELOAD) {
+                    db_.add_entry_worker(move(e));
+                } else {
+                    db_.stage_add_entry_worker(move(e));
+                }
+            }
         }
 
         /** @brief Begin waiting for a barrier */
@@ -664,9 +1160,22 @@ class ParDB : public PandoParticipant {
                 local_recv_dist_ = 0;
 
                 // We have received all required messages, and need to sent
-                // that we are at the barrier to the synchronizer
+                // that we are at the barrier to the synchronizer, along with
+                // the replicated keys written since the last barrier
+                // <AT_BARRIER> <foreach key: <key>>
+                size_t msg_size = sizeof(msg_type_t)+replica_writes_.size()*sizeof(dbkey_t);
+                char* msg = new char[msg_size];
+                char* msg_ptr = msg;
+
+                pack_msg(msg_ptr, AT_BARRIER);
+                for (auto & key : replica_writes_)
+                    pack_single(msg_ptr, key);
+                replica_writes_.clear();
+
                 auto req = find_req(sync_key);
-                req->send(AT_BARRIER);
+                req->send(msg, msg_size);
+
+                delete [] msg;
             } else {
                 waiting_for_barrier_ = true;
             }
@@ -679,18 +1188,36 @@ class ParDB : public PandoParticipant {
             check_at_barrier();
         }
 
-        void recv_at_barrier([[maybe_unused]] zmq_socket_t sock, [[maybe_unused]] const char* data, [[maybe_unused]] const char* end) {
+        void recv_at_barrier([[maybe_unused]] zmq_socket_t sock, const char* data, const char* end) {
             #ifdef VERBOSE
             cerr << "sync_recv_at_barrier_ = " << sync_recv_at_barrier_ + 1 << ", num_neighbors = " << num_neighbors() << endl;
             #endif
+            while (data < end) {
+                dbkey_t key;
+                unpack_single(data, key);
+                sync_replica_writes_.insert(key);
+            }
+
             if (++sync_recv_at_barrier_ == num_neighbors()) {
                 // Everyone has gotten to the barrier
-                // The barrier is now over
-                msg_type_t msg = END_BARRIER;
-                pub((char*)&msg, sizeof(msg));
+                // The barrier is now over, and every replica of a written key
+                // is dropped
+                // <END_BARRIER> <foreach key: <key>>
+                size_t msg_size = sizeof(msg_type_t)+sync_replica_writes_.size()*sizeof(dbkey_t);
+                char* msg = new char[msg_size];
+                char* msg_ptr = msg;
+
+                pack_msg(msg_ptr, END_BARRIER);
+                for (auto & key : sync_replica_writes_)
+                    pack_single(msg_ptr, key);
+                sync_replica_writes_.clear();
+
+                pub(msg, msg_size);
                 // Also, send to ourselves
                 auto req = get_req(addr_.serialize());
-                req->send(END_BARRIER);
+                req->send(msg, msg_size);
+
+                delete [] msg;
             }
         }
 
@@ -699,7 +1226,9 @@ class ParDB : public PandoParticipant {
             #ifdef VERBOSE
             cerr << "about to process filters" << endl;
             #endif
+            batch_ops_ = true;
             local_process_again_ = db_.process();
+            flush_outboxes();
             #ifdef VERBOSE
             cerr << "finished process filters" << endl;
             #endif
@@ -719,10 +1248,19 @@ class ParDB : public PandoParticipant {
         }
         void end_barrier_stage_processed() {
             state_ = STAGE_CLOSING;
+            // Staged changes are about to be made, so cached lookups go stale
+            clear_lookup_cache_();
             #ifdef VERBOSE
             cerr << "starting stage close" << endl;
             #endif
+            batch_ops_ = true;
             db_.stage_close();
+            flush_outboxes();
+
+            replica_writes_.merge(staged_replica_writes_);
+            staged_replica_writes_.clear();
+            // Entries woken by this close need another stage
+            local_process_again_ |= db_.has_ready();
             #ifdef VERBOSE
             cerr << "finished stage close" << endl;
             #endif
@@ -731,6 +1269,11 @@ class ParDB : public PandoParticipant {
             start_barrier_wait();
         }
         void end_barrier_stage_closing() {
+            // The owners have had this stage's replication requests since
+            // before they closed it, so will report any later writes
+            replicated_keys_.merge(replicas_requested_);
+            replicas_requested_.clear();
+
             // Now all agents have closed their stages
             // We can start the loop again
             if (local_process_again_) {
@@ -834,11 +1377,18 @@ class ParDB : public PandoParticipant {
             // Just wait until we have all messages; do nothing more here
         }
 
-        void recv_end_barrier([[maybe_unused]] zmq_socket_t sock, [[maybe_unused]] const char* data, [[maybe_unused]] const char* end) {
+        void recv_end_barrier([[maybe_unused]] zmq_socket_t sock, const char* data, const char* end) {
             // The barrier is over, we have not done anything inside of the barrier
             // So, zero out the sent counters
             sent_distribution_.clear();
 
+            // Drop the replicas of keys written before the barrier
+            while (data < end) {
+                dbkey_t key;
+                unpack_single(data, key);
+                drop_replica_(key);
+            }
+
             // Proceed to the next state, depending on current state
             if (state_ == STAGE_BEGIN) {
                 end_barrier_stage_begin();
@@ -939,6 +1489,113 @@ class ParDB : public PandoParticipant {
             delete [] msg;
         }
 
+        /** @brief Start a query returned a page at a time
+         *
+         * The message is <page entries (size_t)><fields (uint8_t)>
+         * <value prefix (size_t)><num tags (size_t)><null-terminated tags>,
+         * and the reply is the first page (see send_query_page_).
+         */
+        void recv_query_page(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            size_t page_size = unpack_single<size_t>(data);
+            QueryCursor cursor;
+            cursor.fields = unpack_single<uint8_t>(data);
+            cursor.value_prefix = unpack_single<size_t>(data);
+            size_t num_tags = unpack_single<size_t>(data);
+            vector<string> tags;
+            for (size_t i = 0; i < num_tags; i++) {
+                string tag {data};
+                data += tag.size() + 1;
+                tags.push_back(tag);
+            }
+            cursor.keys = db_.query(tags);
+
+            if (query_cursors_.size() >= MAX_QUERY_CURSORS)
+                query_cursors_.erase(query_cursors_.begin());
+            uint64_t id = next_query_cursor_++;
+            query_cursors_.emplace(id, move(cursor));
+
+            send_query_page_(sock, id, page_size);
+        }
+
+        /** @brief Return the next page of an open query
+         *
+         * The message is <cursor (uint64_t)><page entries (size_t)>.
+         */
+        void recv_query_next(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            uint64_t id = unpack_single<uint64_t>(data);
+            size_t page_size = unpack_single<size_t>(data);
+            send_query_page_(sock, id, page_size);
+        }
+
+        /** @brief Drop an open query before it is read to the end */
+        void recv_query_close(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            query_cursors_.erase(unpack_single<uint64_t>(data));
+            ack(sock);
+        }
+
+        /** @brief Aggregate the values of this agent's matching entries
+         *
+         * The message is <group by (null terminated)><num tags (size_t)>
+         * <null-terminated tags>, and the reply is the partial aggregates
+         * (see pack_aggregates).
+         */
+        void recv_aggregate(zmq_socket_t sock, const char* data, [[maybe_unused]] const char* end) {
+            string group_by {data};
+            data += group_by.size() + 1;
+            size_t num_tags = unpack_single<size_t>(data);
+            vector<string> tags;
+            for (size_t i = 0; i < num_tags; i++) {
+                string tag {data};
+                data += tag.size() + 1;
+                tags.push_back(tag);
+            }
+
+            aggregates_t aggs = db_.aggregate(tags, group_by);
+
+            size_t msg_size = aggregates_size(aggs);
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+            pack_aggregates(msg_ptr, aggs);
+
+            send(sock, msg, msg_size);
+
+            delete [] msg;
+        }
+
+        /** @brief Reply with the next page of a query
+         *
+         * The reply is <cursor (uint64_t)><entries, as SeqDB serializes
+         * them>.  The cursor is 0 once the query has no more pages, after
+         * which it is dropped, and QUERY_CURSOR_EXPIRED (with no entries)
+         * if it was not open.
+         */
+        void send_query_page_(zmq_socket_t sock, uint64_t id, size_t page_size) {
+            vector<DBEntry<>> page;
+            uint64_t next = QUERY_CURSOR_EXPIRED;
+            auto it = query_cursors_.find(id);
+            if (it != query_cursors_.end()) {
+                QueryCursor& cursor = it->second;
+                cursor.pos = db_.query_page(cursor.keys, cursor.pos, max<size_t>(page_size, 1),
+                        QUERY_PAGE_MAX_BYTES, cursor.fields, cursor.value_prefix, page);
+                next = id;
+                if (cursor.pos == cursor.keys.size()) {
+                    query_cursors_.erase(it);
+                    next = 0;
+                }
+            }
+
+            size_t msg_size = sizeof(uint64_t);
+            if (next != QUERY_CURSOR_EXPIRED) msg_size += SeqDB::serialize_size(page);
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+            pack_single(msg_ptr, next);
+            if (next != QUERY_CURSOR_EXPIRED) SeqDB::serialize_entries(msg_ptr, page);
+
+            send(sock, msg, msg_size);
+
+            delete [] msg;
+        }
+
         void recv_processing(zmq_socket_t sock, [[maybe_unused]] const char* data, [[maybe_unused]] const char* end) {
             bool is_processing = state_ != PRELOAD;
 
@@ -963,6 +1620,7 @@ class ParDB : public PandoParticipant {
             // Check if we are the owner of the data
             if (has_ownership(e.get_key())) {
                 update_recv_dist();
+                note_replica_write_(e.get_key());
 
                 // If so, add to our database
                 if (state_ == STAGE_CLOSING || state_ == PRELOAD) {
@@ -981,7 +1639,7 @@ class ParDB : public PandoParticipant {
             }
 
             // If necessary, respond with an acknowledgement
-            if (ZMQRequester::is_reqrep_sock(sock))
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
                 ack(sock);
         }
 
@@ -1012,7 +1670,7 @@ class ParDB : public PandoParticipant {
             }
 
             // If necessary, respond with an acknowledgement
-            if (ZMQRequester::is_reqrep_sock(sock))
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
                 ack(sock);
         }
         
@@ -1039,7 +1697,7 @@ class ParDB : public PandoParticipant {
             }
 
             // If necessary, respond with an acknowledgement
-            if (ZMQRequester::is_reqrep_sock(sock))
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
                 ack(sock);
 
         }
@@ -1053,6 +1711,8 @@ class ParDB : public PandoParticipant {
             if (has_ownership(key)) {
                 update_recv_dist();
 
+                note_replica_write_(key);
+
                 // We can only process if we are in a state of having finished
                 // our process() call, and currently closing the stage
                 if (state_ == STAGE_CLOSING || state_ == PRELOAD) db_.update_entry_val(key, val);
@@ -1067,7 +1727,7 @@ class ParDB : public PandoParticipant {
             }
 
             // If necessary, respond with an acknowledgement
-            if (ZMQRequester::is_reqrep_sock(sock))
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
                 ack(sock);
 
         }
@@ -1096,7 +1756,7 @@ class ParDB : public PandoParticipant {
             }
 
             // If necessary, respond with an acknowledgement
-            if (ZMQRequester::is_reqrep_sock(sock))
+            if (sock != NULL && ZMQRequester::is_reqrep_sock(sock))
                 ack(sock);
 
         }
@@ -1151,6 +1811,7 @@ class ParDB : public PandoParticipant {
         /** @brief Load a text file of entries into the DB */
         void add_db_file(string f) {
             db_.add_db_file(f);
+            note_all_replicas_written_();
         }
 
         /** @brief Get a copy of the internal DB (For testing only)*/
@@ -1344,4 +2005,8 @@ void s_ref_get_entry_by_key(fn_ref r, dbkey_t search_key, char** res) {
     ParDB* db = (ParDB*)r;
     db->get_entry_by_key(search_key, res);
 }
+void s_ref_get_entries_by_keys(fn_ref r, size_t num_keys, const dbkey_t* search_keys, char** res) {
+    ParDB* db = (ParDB*)r;
+    db->get_entries_by_keys(num_keys, search_keys, res);
+}
 }
@@ -11,6 +11,7 @@ typedef void (*fn_remove_tag_from_entry)(void*, dbkey_t, string);
 typedef void (*fn_update_entry_val)(void*, dbkey_t, string);
 typedef void (*fn_subscribe_to_entry)(void*, dbkey_t, dbkey_t, string);
 typedef void (*fn_get_entry_by_key)(void*, dbkey_t, char**);
+typedef void (*fn_get_entries_by_keys)(void*, size_t, const dbkey_t*, char**);
 
 typedef struct fn_refs {
     fn_ref ref;
@@ -20,6 +21,7 @@ typedef struct fn_refs {
     fn_update_entry_val update_entry_val;
     fn_subscribe_to_entry subscribe_to_entry;
     fn_get_entry_by_key get_entry_by_key;
+    fn_get_entries_by_keys get_entries_by_keys;
 
     fn_refs(
         fn_ref ref,
@@ -28,7 +30,8 @@ typedef struct fn_refs {
         fn_remove_tag_from_entry remove_tag_from_entry,
         fn_update_entry_val update_entry_val,
         fn_subscribe_to_entry subscribe_to_entry,
-        fn_get_entry_by_key get_entry_by_key
+        fn_get_entry_by_key get_entry_by_key,
+        fn_get_entries_by_keys get_entries_by_keys
     ) :
         ref(ref),
         add_entry(add_entry),
@@ -36,7 +39,8 @@ typedef struct fn_refs {
         remove_tag_from_entry(remove_tag_from_entry),
         update_entry_val(update_entry_val),
         subscribe_to_entry(subscribe_to_entry),
-        get_entry_by_key(get_entry_by_key)
+        get_entry_by_key(get_entry_by_key),
+        get_entries_by_keys(get_entries_by_keys)
         { }
 } fn_refs;
 
@@ -44,14 +48,32 @@ typedef struct fn_refs {
 class SeqDBParAccess : public AlgDB {
     private:
         fn_refs b_refs_;
+
+        /** @brief New entries with a commutative merge operator, merged by
+         * key until the filters finish so each key is sent once */
+        absl::flat_hash_map<dbkey_t, DBEntry<>> combined_;
+
+        /** @brief Send the combined entries early once there are this many */
+        constexpr static size_t COMBINED_MAX_ENTRIES = 1<<20;
+
+        void send_combined_() {
+            for (auto & [key, entry] : combined_)
+                b_refs_.add_entry(b_refs_.ref, move(entry));
+            combined_.clear();
+        }
+
     public:
         SeqDBParAccess(fn_refs refs, addr_t addr, size_t sz) : AlgDB(addr, sz), b_refs_(refs) { }
 
         virtual bool process() {
-            return run_filters_();
+            bool ret = run_filters_();
+            send_combined_();
+            return ret;
         }
 
         virtual void stage_close() {
+            send_combined_();
+
             // Add new entries
             for (auto & [key, entry] : new_entries_) {
                 b_refs_.add_entry(b_refs_.ref, move(entry));
@@ -83,8 +105,26 @@ class SeqDBParAccess : public AlgDB {
             b_refs_.remove_tag_from_entry(b_refs_.ref, key, tag);
         }
 
+        /** @brief Send a new entry to its owner
+         *
+         * Entries merged by a commutative operator (such as
+         * MERGE_STRATEGY=SUM) are first merged with the others this stage
+         * at the same key, so the owner gets one entry per key.
+         */
         virtual void stage_add_entry(DBEntry<> entry) {
-            b_refs_.add_entry(b_refs_.ref, move(entry));
+            if (entry.get_key() == INITIAL_KEY || !merge_op_commutative(merge_op(entry))) {
+                b_refs_.add_entry(b_refs_.ref, move(entry));
+                return;
+            }
+
+            auto it = combined_.find(entry.get_key());
+            if (it != combined_.end()) {
+                merge_entries(&it->second, &entry);
+                it->second = move(entry);
+            } else {
+                combined_.insert({entry.get_key(), move(entry)});
+                if (combined_.size() >= COMBINED_MAX_ENTRIES) send_combined_();
+            }
         }
 
         virtual void stage_add_tag(dbkey_t key, string tag) {
@@ -100,6 +140,11 @@ class SeqDBParAccess : public AlgDB {
             b_refs_.get_entry_by_key(b_refs_.ref, search_key, res);
         }
 
+        /** @brief Get the values of the entries with the given keys */
+        virtual void get_entry_values_by_keys(size_t num_keys, const dbkey_t* keys, char **res) {
+            b_refs_.get_entries_by_keys(b_refs_.ref, num_keys, keys, res);
+        }
+
         virtual void subscribe_to_entry_wrapper(dbkey_t my_key, dbkey_t wait_key, string tag) {
             b_refs_.subscribe_to_entry(b_refs_.ref, my_key, wait_key, tag);
         }
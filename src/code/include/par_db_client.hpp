@@ -22,6 +22,17 @@ class ParDBClient : ZMQChatterbox {
         /** @brief Contains the persistent connection to the server */
         ZMQRequester req_;
 
+        /** @brief Read a page of query results, and the cursor for the
+         * next one */
+        vector<DBEntry<>> read_query_page_(uint64_t& cursor) {
+            ZMQMessage resp = req_.read();
+            const char* resp_data = resp.data();
+            cursor = unpack_single<uint64_t>(resp_data);
+            if (cursor == QUERY_CURSOR_EXPIRED)
+                throw runtime_error("Query cursor expired");
+            return SeqDB::deserialize_entries(resp_data);
+        }
+
     public:
         /** @brief Start the client and connect to a ParDB */
         ParDBClient(ZMQAddress server_address) :
@@ -161,6 +172,31 @@ class ParDBClient : ZMQChatterbox {
             req_.wait_ack();
         }
 
+        /** @brief Have every DB check all entries in the next stage */
+        void full_scan() {
+            req_.send(FULL_SCAN_BROADCAST);
+            req_.wait_ack();
+        }
+
+        /** @brief Merge entries in a key family as if they had a merge
+         * strategy tag, on every DB (see SeqDB::set_merge_strategy) */
+        void set_merge_strategy(chain_info_t key_a_mask, chain_info_t key_a_value, string strategy) {
+            size_t msg_size = sizeof(msg_type_t) + 2*sizeof(chain_info_t) + strategy.size();
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, SET_MERGE_STRATEGY_BROADCAST);
+            pack_single(msg_ptr, key_a_mask);
+            pack_single(msg_ptr, key_a_value);
+            pack_string(msg_ptr, strategy);
+
+            req_.send(msg, msg_size);
+
+            delete [] msg;
+
+            req_.wait_ack();
+        }
+
         /** @brief Get an entry's value by key */
         string get_entry_by_key(dbkey_t k) {
             size_t msg_size = sizeof(msg_type_t) + sizeof(dbkey_t);
@@ -239,6 +275,88 @@ class ParDBClient : ZMQChatterbox {
             return query(tags);
         }
 
+        /** @brief Start a query returned a page at a time
+         *
+         * @param cursor set to the cursor for query_next, or 0 if this
+         *        was the last page
+         * @param page_size the most entries in each page
+         * @param fields which of QUERY_TAGS and QUERY_VALUE to return
+         * @param value_prefix the most bytes of each value to return
+         */
+        vector<DBEntry<>> query_page(const vector<string>& tags, uint64_t& cursor, size_t page_size,
+                uint8_t fields=QUERY_ALL, size_t value_prefix=SIZE_MAX) {
+            size_t msg_size = sizeof(msg_type_t) + sizeof(size_t) + sizeof(uint8_t) + 2*sizeof(size_t);
+            for (auto & tag : tags) msg_size += (tag.size()+1); // add 1 extra for null terminator
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, QUERY_PAGE);
+            pack_single(msg_ptr, page_size);
+            pack_single(msg_ptr, fields);
+            pack_single(msg_ptr, value_prefix);
+            pack_single(msg_ptr, tags.size());
+            for (auto & tag : tags) pack_string_null_term(msg_ptr, tag);
+
+            req_.send(msg, msg_size);
+
+            delete [] msg;
+
+            return read_query_page_(cursor);
+        }
+
+        /** @brief Return the next page of a query, updating its cursor */
+        vector<DBEntry<>> query_next(uint64_t& cursor, size_t page_size) {
+            size_t msg_size = sizeof(msg_type_t) + sizeof(uint64_t) + sizeof(size_t);
+            char msg[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, QUERY_NEXT);
+            pack_single(msg_ptr, cursor);
+            pack_single(msg_ptr, page_size);
+
+            req_.send(msg, msg_size);
+
+            return read_query_page_(cursor);
+        }
+
+        /** @brief Drop a query that will not be read to the end */
+        void query_close(uint64_t cursor) {
+            size_t msg_size = sizeof(msg_type_t) + sizeof(uint64_t);
+            char msg[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, QUERY_CLOSE);
+            pack_single(msg_ptr, cursor);
+
+            req_.send(msg, msg_size);
+            req_.wait_ack();
+        }
+
+        /** @brief Aggregate the values of this agent's entries with all of
+         * the tags
+         *
+         * @param group_by how entries are grouped (see aggregate_group)
+         */
+        aggregates_t aggregate(const vector<string>& tags, const string& group_by="") {
+            size_t msg_size = sizeof(msg_type_t) + group_by.size()+1 + sizeof(size_t);
+            for (auto & tag : tags) msg_size += (tag.size()+1); // add 1 extra for null terminator
+            char* msg = new char[msg_size];
+            char* msg_ptr = msg;
+
+            pack_msg(msg_ptr, AGGREGATE);
+            pack_string_null_term(msg_ptr, group_by);
+            pack_single(msg_ptr, tags.size());
+            for (auto & tag : tags) pack_string_null_term(msg_ptr, tag);
+
+            req_.send(msg, msg_size);
+
+            delete [] msg;
+
+            ZMQMessage resp = req_.read();
+            const char* resp_data = resp.data();
+            return unpack_aggregates(resp_data);
+        }
+
         vector<string> neighbors() {
             size_t msg_size = sizeof(msg_type_t);
             char* msg = new char[msg_size];
@@ -270,12 +388,17 @@ class ParDBClient : ZMQChatterbox {
             return ret;
         }
 
-        void import_db(string dir) {
+        /** @brief Import exported files
+         *
+         * @param routed read the files on this agent alone, sending each
+         *        entry straight to its owner (see ParDB::import_db_routed)
+         */
+        void import_db(string dir, bool routed=false) {
             size_t msg_size = dir.size() + sizeof(msg_type_t);
             char* msg = new char[msg_size];
             char* msg_ptr = msg;
 
-            pack_msg(msg_ptr, IMPORT_DB_DISTRIBUTE);
+            pack_msg(msg_ptr, routed ? IMPORT_DB_ROUTED : IMPORT_DB_DISTRIBUTE);
 
             strncpy(msg_ptr, dir.c_str(), dir.size());
 
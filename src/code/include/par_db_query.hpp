@@ -0,0 +1,130 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "par_db_client.hpp"
+
+using namespace std;
+
+namespace pando {
+
+/** @brief Reads a query's results from every agent, a page at a time
+ *
+ * Each agent gets its own connection with one page request in flight, so
+ * while the caller works through a page, the next page from every agent is
+ * already on its way.  Pages are returned in the order they arrive.
+ */
+class ParDBQuery {
+    private:
+        struct Source {
+            unique_ptr<ParDBClient> client;
+            /** @brief The agent's cursor, 0 once it has no more pages */
+            uint64_t cursor = 0;
+            bool started = false;
+            /** @brief The page being fetched, invalid once done */
+            future<vector<DBEntry<>>> next;
+        };
+
+        vector<string> tags_;
+        size_t page_size_;
+        uint8_t fields_;
+        size_t value_prefix_;
+
+        vector<Source> sources_;
+        /** @brief The source to check first, so no agent is starved */
+        size_t turn_ = 0;
+
+        void fetch_(Source& s) {
+            s.next = async(launch::async, [this, &s]() {
+                if (s.started) return s.client->query_next(s.cursor, page_size_);
+                s.started = true;
+                return s.client->query_page(tags_, s.cursor, page_size_, fields_, value_prefix_);
+            });
+        }
+
+    public:
+        /** @brief Start the query on every agent
+         *
+         * @param addrs the agents, as from ParDBClient::neighbors
+         * @param page_size the most entries in each page
+         * @param fields which of QUERY_TAGS and QUERY_VALUE to return
+         * @param value_prefix the most bytes of each value to return
+         */
+        ParDBQuery(const vector<string>& addrs, vector<string> tags, size_t page_size,
+                uint8_t fields=QUERY_ALL, size_t value_prefix=SIZE_MAX) :
+                tags_(move(tags)), page_size_(page_size), fields_(fields),
+                value_prefix_(value_prefix), sources_(addrs.size()) {
+            for (size_t i = 0; i < addrs.size(); ++i) {
+                sources_[i].client = make_unique<ParDBClient>(addrs[i]);
+                fetch_(sources_[i]);
+            }
+        }
+
+        ParDBQuery(const ParDBQuery&) = delete;
+        ParDBQuery& operator=(const ParDBQuery&) = delete;
+
+        /** @brief Wait for outstanding pages and drop unfinished queries */
+        ~ParDBQuery() {
+            for (auto & s : sources_) {
+                try {
+                    if (s.next.valid()) s.next.get();
+                    if (s.cursor != 0) s.client->query_close(s.cursor);
+                } catch (const exception&) { }
+            }
+        }
+
+        /** @brief Return the next non-empty page, or false once every agent
+         * is done */
+        bool next_page(vector<DBEntry<>>& page) {
+            while (true) {
+                // Take a page that has already arrived, if any
+                size_t pending = sources_.size();
+                for (size_t i = 0; i < sources_.size(); ++i) {
+                    size_t at = (turn_ + i) % sources_.size();
+                    if (!sources_[at].next.valid()) continue;
+                    if (pending == sources_.size()) pending = at;
+                    if (sources_[at].next.wait_for(chrono::seconds(0)) == future_status::ready) {
+                        pending = at;
+                        break;
+                    }
+                }
+                if (pending == sources_.size()) return false;
+
+                Source& s = sources_[pending];
+                page = s.next.get();
+                if (s.cursor != 0) fetch_(s);
+                turn_ = pending + 1;
+                if (!page.empty()) return true;
+            }
+        }
+};
+
+/** @brief Aggregate the values of the entries with all of the tags, over
+ * every agent
+ *
+ * Each agent aggregates its own entries concurrently, and only the partial
+ * aggregates are sent back and merged.
+ *
+ * @param addrs the agents, as from ParDBClient::neighbors
+ * @param group_by how entries are grouped (see aggregate_group)
+ */
+inline aggregates_t aggregate_all(const vector<string>& addrs, const vector<string>& tags, const string& group_by="") {
+    vector<future<aggregates_t>> partials;
+    for (auto & addr : addrs) {
+        partials.push_back(async(launch::async, [&]() {
+            ParDBClient client {addr};
+            return client.aggregate(tags, group_by);
+        }));
+    }
+
+    aggregates_t aggs;
+    for (auto & partial : partials)
+        for (auto & [group, agg] : partial.get())
+            aggs[group].merge(agg);
+    return aggs;
+}
+
+}
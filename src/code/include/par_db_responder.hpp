@@ -20,6 +20,9 @@ class PandoResponder : public PandoParticipant {
         RandomKeyGen random_key_gen_;
         PandoMapClient db_;
     public:
+        /** @brief Sent in place of a value's size when its key does not exist */
+        constexpr static size_t NOT_FOUND = (size_t)-1;
+
         /** @brief Initialize the proxy without joining as an agent */
         PandoResponder(ZMQAddress addr) : 
                 PandoParticipant(addr, false),
@@ -32,6 +35,8 @@ class PandoResponder : public PandoParticipant {
         virtual void process_msg(msg_type_t type, zmq_socket_t sock, const char *data, [[maybe_unused]] const char* end) {
             if (type == GET_ENTRY_BY_KEY)
                 recv_get_entry_by_key(sock, data, end);
+            else if (type == GET_ENTRIES_BY_KEYS)
+                recv_get_entries_by_keys(sock, data, end);
             else recv_unknown_msg();
         }
 
@@ -55,6 +60,33 @@ class PandoResponder : public PandoParticipant {
 
             delete [] msg;
         }
+
+        /** @brief Look up several keys, replying with
+         * <foreach key: <size, or NOT_FOUND> <value>> */
+        void recv_get_entries_by_keys(zmq_socket_t sock, const char* data, const char* end) {
+            vector<string> values;
+            vector<bool> found;
+            size_t msg_size = 0;
+            while (data < end) {
+                dbkey_t key;
+                unpack_single(data, key);
+
+                auto [entry, exists] = db_.retrieve_if_exists(key);
+                found.push_back(exists);
+                values.push_back(exists ? move(entry.value()) : string{});
+                msg_size += sizeof(size_t)+values.back().size();
+            }
+
+            vector<char> msg(msg_size);
+            char* msg_ptr = msg.data();
+            for (size_t i = 0; i < values.size(); ++i) {
+                pack_single(msg_ptr, found[i] ? values[i].size() : NOT_FOUND);
+                memcpy(msg_ptr, values[i].data(), values[i].size());
+                msg_ptr += values[i].size();
+            }
+
+            send(sock, msg.data(), msg.size());
+        }
 };
 
 }
@@ -23,7 +23,7 @@ class ParDBThread {
         volatile sig_atomic_t shutdown_;
     public:
         /** @brief Initialize a ParDB and run its server on a new thread */
-        ParDBThread(ZMQAddress addr, size_t sz, bool skip_group_filters) : db_(addr, sz, skip_group_filters), shutdown_(false) {
+        ParDBThread(ZMQAddress addr, size_t sz, bool skip_group_filters, bool ipc_map=false, double compact_threshold=0, size_t filter_threads=1, bool incremental=false) : db_(addr, sz, skip_group_filters, ipc_map, compact_threshold, filter_threads, incremental), shutdown_(false) {
             t_ = thread(&ParDBThread::launch, this);
         }
 
@@ -56,6 +56,11 @@ class ParDBThread {
             }
         }
 
+        /** @brief Return the hosted object, e.g., to call it in-process */
+        T& get() {
+            return db_;
+        }
+
         volatile sig_atomic_t* get_shutdown_flag() {
             return &shutdown_;
         }
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+namespace pando {
+
+/** @brief A compressed, sorted set of 32-bit ids
+ *
+ * Ids are split on their high 16 bits into containers.  A container holds
+ * its low 16 bits as a sorted array while it has at most ARRAY_MAX ids, and
+ * as a 65536-bit bitmap once it has more, so sparse and dense lists both
+ * stay small.  Intersections and differences work container by container,
+ * with the bitmap cases done a word at a time.
+ */
+class PostingList {
+    public:
+        /** @brief The most ids a container holds as an array */
+        constexpr static size_t ARRAY_MAX = 4096;
+
+    private:
+        constexpr static size_t BITMAP_WORDS = (1<<16)/64;
+
+        struct Container {
+            uint16_t high;
+            uint32_t cardinality = 0;
+            /** @brief The sorted low bits, when not a bitmap */
+            vector<uint16_t> array;
+            /** @brief BITMAP_WORDS words, or empty when an array */
+            vector<uint64_t> bits;
+
+            bool is_bitmap() const { return !bits.empty(); }
+
+            bool contains(uint16_t low) const {
+                if (is_bitmap()) return (bits[low >> 6] >> (low & 63)) & 1;
+                return binary_search(array.begin(), array.end(), low);
+            }
+
+            void to_bitmap() {
+                bits.assign(BITMAP_WORDS, 0);
+                for (uint16_t low : array) bits[low >> 6] |= 1ull << (low & 63);
+                array.clear();
+                array.shrink_to_fit();
+            }
+
+            void to_array() {
+                array.clear();
+                array.reserve(cardinality);
+                for_each([&](uint16_t low) { array.push_back(low); });
+                bits.clear();
+                bits.shrink_to_fit();
+            }
+
+            /** @brief Pick the smaller form for the current cardinality */
+            void normalize() {
+                if (is_bitmap() && cardinality <= ARRAY_MAX) to_array();
+                else if (!is_bitmap() && cardinality > ARRAY_MAX) to_bitmap();
+            }
+
+            template <typename F>
+            void for_each(F&& f) const {
+                if (!is_bitmap()) {
+                    for (uint16_t low : array) f(low);
+                    return;
+                }
+                for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+                    for (uint64_t word = bits[w]; word != 0; word &= word-1)
+                        f((uint16_t)(w*64 + __builtin_ctzll(word)));
+                }
+            }
+        };
+
+        /** @brief Non-empty containers, sorted by their high bits */
+        vector<Container> containers_;
+        size_t cardinality_ = 0;
+
+        vector<Container>::iterator find_(uint16_t high) {
+            return lower_bound(containers_.begin(), containers_.end(), high,
+                [](const Container& c, uint16_t h) { return c.high < h; });
+        }
+        vector<Container>::const_iterator find_(uint16_t high) const {
+            return lower_bound(containers_.begin(), containers_.end(), high,
+                [](const Container& c, uint16_t h) { return c.high < h; });
+        }
+
+        /** @brief Intersect two arrays, searching the larger one when their
+         * sizes are far apart */
+        static void intersect_arrays_(const vector<uint16_t>& a, const vector<uint16_t>& b, vector<uint16_t>& out) {
+            const vector<uint16_t>& small = a.size() <= b.size() ? a : b;
+            const vector<uint16_t>& large = a.size() <= b.size() ? b : a;
+            out.clear();
+            if (small.size()*32 < large.size()) {
+                auto from = large.begin();
+                for (uint16_t low : small) {
+                    from = lower_bound(from, large.end(), low);
+                    if (from == large.end()) break;
+                    if (*from == low) out.push_back(low);
+                }
+            } else
+                set_intersection(small.begin(), small.end(), large.begin(), large.end(), back_inserter(out));
+        }
+
+        /** @brief Intersect (or, with negate, subtract) another container
+         * into this one */
+        static void combine_(Container& c, const Container& other, bool negate) {
+            if (c.is_bitmap() && other.is_bitmap()) {
+                uint64_t* words = c.bits.data();
+                const uint64_t* other_words = other.bits.data();
+                uint32_t cardinality = 0;
+                for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+                    words[w] &= negate ? ~other_words[w] : other_words[w];
+                    cardinality += __builtin_popcountll(words[w]);
+                }
+                c.cardinality = cardinality;
+            } else if (c.is_bitmap()) {
+                // Only the other container's ids can change anything
+                if (negate) {
+                    for (uint16_t low : other.array) {
+                        uint64_t bit = 1ull << (low & 63);
+                        if (c.bits[low >> 6] & bit) {
+                            c.bits[low >> 6] &= ~bit;
+                            --c.cardinality;
+                        }
+                    }
+                } else {
+                    vector<uint16_t> kept;
+                    for (uint16_t low : other.array)
+                        if (c.contains(low)) kept.push_back(low);
+                    c.bits.clear();
+                    c.bits.shrink_to_fit();
+                    c.array = move(kept);
+                    c.cardinality = c.array.size();
+                }
+            } else if (other.is_bitmap() || negate) {
+                auto end = remove_if(c.array.begin(), c.array.end(),
+                    [&](uint16_t low) { return other.contains(low) == negate; });
+                c.array.erase(end, c.array.end());
+                c.cardinality = c.array.size();
+            } else {
+                vector<uint16_t> kept;
+                intersect_arrays_(c.array, other.array, kept);
+                c.array = move(kept);
+                c.cardinality = c.array.size();
+            }
+            c.normalize();
+        }
+
+        void recount_() {
+            cardinality_ = 0;
+            for (auto & c : containers_) cardinality_ += c.cardinality;
+        }
+
+    public:
+        /** @brief Add an id, returning whether it was new */
+        bool add(uint32_t id) {
+            uint16_t high = id >> 16, low = id & 0xffff;
+            auto c = find_(high);
+            if (c == containers_.end() || c->high != high) {
+                c = containers_.insert(c, Container {});
+                c->high = high;
+            }
+
+            if (c->is_bitmap()) {
+                uint64_t bit = 1ull << (low & 63);
+                if (c->bits[low >> 6] & bit) return false;
+                c->bits[low >> 6] |= bit;
+            } else {
+                auto pos = lower_bound(c->array.begin(), c->array.end(), low);
+                if (pos != c->array.end() && *pos == low) return false;
+                c->array.insert(pos, low);
+            }
+            ++c->cardinality;
+            ++cardinality_;
+            c->normalize();
+            return true;
+        }
+
+        /** @brief Remove an id, returning whether it was present */
+        bool remove(uint32_t id) {
+            uint16_t high = id >> 16, low = id & 0xffff;
+            auto c = find_(high);
+            if (c == containers_.end() || c->high != high) return false;
+
+            if (c->is_bitmap()) {
+                uint64_t bit = 1ull << (low & 63);
+                if (!(c->bits[low >> 6] & bit)) return false;
+                c->bits[low >> 6] &= ~bit;
+            } else {
+                auto pos = lower_bound(c->array.begin(), c->array.end(), low);
+                if (pos == c->array.end() || *pos != low) return false;
+                c->array.erase(pos);
+            }
+            --c->cardinality;
+            --cardinality_;
+            if (c->cardinality == 0)
+                containers_.erase(c);
+            else
+                c->normalize();
+            return true;
+        }
+
+        bool contains(uint32_t id) const {
+            uint16_t high = id >> 16;
+            auto c = find_(high);
+            return c != containers_.end() && c->high == high && c->contains(id & 0xffff);
+        }
+
+        /** @brief Return the number of ids, without counting them */
+        size_t cardinality() const { return cardinality_; }
+
+        bool empty() const { return cardinality_ == 0; }
+
+        /** @brief Keep only the ids also in another list */
+        PostingList& intersect_with(const PostingList& other) {
+            vector<Container> kept;
+            auto o = other.containers_.begin();
+            for (auto & c : containers_) {
+                while (o != other.containers_.end() && o->high < c.high) ++o;
+                if (o == other.containers_.end()) break;
+                if (o->high != c.high) continue;
+                combine_(c, *o, false);
+                if (c.cardinality > 0) kept.push_back(move(c));
+            }
+            containers_ = move(kept);
+            recount_();
+            return *this;
+        }
+
+        /** @brief Drop the ids that are in another list */
+        PostingList& subtract(const PostingList& other) {
+            vector<Container> kept;
+            auto o = other.containers_.begin();
+            for (auto & c : containers_) {
+                while (o != other.containers_.end() && o->high < c.high) ++o;
+                if (o != other.containers_.end() && o->high == c.high)
+                    combine_(c, *o, true);
+                if (c.cardinality > 0) kept.push_back(move(c));
+            }
+            containers_ = move(kept);
+            recount_();
+            return *this;
+        }
+
+        /** @brief Call f with each id, in increasing order */
+        template <typename F>
+        void for_each(F&& f) const {
+            for (auto & c : containers_) {
+                uint32_t high = (uint32_t)c.high << 16;
+                c.for_each([&](uint16_t low) { f(high | low); });
+            }
+        }
+};
+
+}
@@ -12,20 +12,28 @@
 #include <iterator>
 #include <algorithm>
 #include <chrono>
-#include <boost/lexical_cast.hpp>
-#include <boost/lexical_cast/bad_lexical_cast.hpp>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "Python.h"
 
 
 #include "pigo.hpp"
 
+#include "aggregate.hpp"
+#include "merge_op.hpp"
 #include "filter.hpp"
 #include "dbentry.hpp"
 #include "random_key_gen.hpp"
 #include "pando_map.hpp"
 #include "pando_map_client.hpp"
+#include "pando_map_local.hpp"
 #include "par_db_thread.hpp"
+#include "posting_list.hpp"
+#include "snapshot.hpp"
 #include "terr.hpp"
 
 using namespace std;
@@ -35,11 +43,17 @@ extern "C" {
 static void s_SeqDB_new_entry(const fn* s_this, ...);
 static void s_SeqDB_get_entry_by_tags(const fn* s_this, ...);
 static void s_SeqDB_get_entry_by_key(const fn* s_this, ...);
+static void s_SeqDB_get_entries_by_keys(const fn* s_this, ...);
 static void s_SeqDB_get_entries_by_tags(const fn* s_this, ...);
 static void s_SeqDB_add_tag(const fn* s_this, ...);
 static void s_SeqDB_remove_tag(const fn* s_this, ...);
 static void s_SeqDB_subscribe_to_entry(const fn* s_this, ...);
 static void s_SeqDB_update_entry_val(const fn* s_this, ...);
+static void s_SeqDB_staged_new_entry(const fn* s_this, ...);
+static void s_SeqDB_staged_add_tag(const fn* s_this, ...);
+static void s_SeqDB_staged_remove_tag(const fn* s_this, ...);
+static void s_SeqDB_staged_subscribe_to_entry(const fn* s_this, ...);
+static void s_SeqDB_staged_update_entry_val(const fn* s_this, ...);
 }
 
 typedef int (*db_query_t)(dbkey_t, const char*, const char* const*, const DBAccess*);
@@ -48,6 +62,51 @@ namespace pando {
 
 static string MERGE_STRATEGY_FORCE = "MERGE_STRATEGY=FORCE_MERGE";
 static string MERGE_STRATEGY_SUM = "MERGE_STRATEGY=SUM";
+static string MERGE_STRATEGY_MIN = "MERGE_STRATEGY=MIN";
+static string MERGE_STRATEGY_MAX = "MERGE_STRATEGY=MAX";
+static string MERGE_STRATEGY_COUNT = "MERGE_STRATEGY=COUNT";
+static string MERGE_STRATEGY_APPEND = "MERGE_STRATEGY=APPEND";
+
+/** @brief Parts of each entry a query page returns, besides its key */
+constexpr uint8_t QUERY_TAGS = 1;
+constexpr uint8_t QUERY_VALUE = 2;
+constexpr uint8_t QUERY_ALL = QUERY_TAGS | QUERY_VALUE;
+
+/** @brief The cursor an agent replies with for a query it no longer has */
+constexpr uint64_t QUERY_CURSOR_EXPIRED = ~0ull;
+
+/** @brief Changes made by filters running on a worker thread
+ *
+ * They are kept in order and handed to the database's stage functions on the
+ * processing thread once the workers finish.
+ */
+struct StagedFilterOps {
+    enum Kind {
+        NEW_ENTRY,
+        ADD_TAG,
+        REMOVE_TAG,
+        SET_VALUE,
+        SUBSCRIBE
+    };
+
+    struct Op {
+        Kind kind;
+        dbkey_t key;
+        /** @brief The entry waited for, for SUBSCRIBE */
+        dbkey_t wait_key;
+        /** @brief The tag or new value */
+        string arg;
+        /** @brief The new entry, for NEW_ENTRY */
+        DBEntry<> entry;
+        /** @brief The filter to wake, for SUBSCRIBE on the running entry */
+        filter_p filter;
+    };
+
+    vector<Op> ops;
+
+    /** @brief The filter running on the worker */
+    filter_p filter;
+};
 
 /** @brief Contains the sequential database
  *
@@ -58,44 +117,68 @@ class SeqDB {
         /** @brief Hold filters by name */
         absl::flat_hash_map<string, filter_p> filters_;
 
-        /** @brief Index entries by tags for easy access*/
-        absl::flat_hash_map<string, set<dbkey_t>> entries_by_tag_;
+        /** @brief Index entries by tag id for easy access, by local id */
+        absl::flat_hash_map<tag_id_t, PostingList> entries_by_tag_;
+
+        /** @brief Dense ids for the keys in the tag index, handed out in the
+         * order keys are first indexed */
+        absl::flat_hash_map<dbkey_t, uint32_t> local_ids_;
+        vector<dbkey_t> local_keys_;
+
+        /** @brief Return the local id of a key, giving it one if needed */
+        uint32_t local_id_(dbkey_t k) {
+            auto [it, inserted] = local_ids_.try_emplace(k, (uint32_t)local_keys_.size());
+            if (inserted) local_keys_.push_back(k);
+            return it->second;
+        }
+
+        /** @brief Find the local id of a key, returning whether it has one */
+        bool find_local_id_(dbkey_t k, uint32_t& id) const {
+            auto it = local_ids_.find(k);
+            if (it == local_ids_.end()) return false;
+            id = it->second;
+            return true;
+        }
+
+        /** @brief Intersect the entries of each tag, smallest first
+         *
+         * @return false if no entry has all of the tags
+         */
+        bool intersect_tags_(const vector<string>& tags, PostingList& matching) {
+            if (tags.size() == 0) return false;
+
+            auto & dict = TagDictionary::get();
+            vector<const PostingList*> lists;
+            for (auto & tag_str : tags) {
+                // Intersection with an empty set is empty
+                auto it = entries_by_tag_.find(dict.find(tag_str));
+                if (it == entries_by_tag_.end()) return false;
+                lists.push_back(&it->second);
+            }
+            sort(lists.begin(), lists.end(),
+                [](auto a, auto b) { return a->cardinality() < b->cardinality(); });
+
+            matching = *lists[0];
+            for (size_t i = 1; i < lists.size() && !matching.empty(); ++i)
+                matching.intersect_with(*lists[i]);
+            return !matching.empty();
+        }
 
         /** @brief Return a set of indices that correspond to a DBEntry's index in db_ */
         set<dbkey_t> get_entry_by_tags_(const char* const* c_tags) {
-            vector<string> tags = Filter::extract_c_tags(c_tags);
-
             set<dbkey_t> matching_entries;
-            set<dbkey_t> empty_set;
-
-            if (tags.size() == 0)
-                return matching_entries;
-
-            //(entry IDs are integer)
-            bool first = true;
-            for (auto & tag : tags) {
-                // Check if the tag exists in the DB; if not, return
-                // (Intersection with an empty set is empty)
-                if (entries_by_tag_.count(tag) == 0) return empty_set;
-
-                // Treat the first tag specially
-                if (first) {
-                    matching_entries = entries_by_tag_[tag];
-                    first = false;
-                } else {
-                    set<dbkey_t> new_entries;
-                    set_intersection(matching_entries.begin(), matching_entries.end(),
-                        entries_by_tag_[tag].begin(), entries_by_tag_[tag].end(),
-                        inserter(new_entries, new_entries.begin()));
-                    matching_entries.swap(new_entries);
-                }
-            }
+            PostingList matching;
+            if (intersect_tags_(Filter::extract_c_tags(c_tags), matching))
+                matching.for_each([&](uint32_t id) { matching_entries.insert(local_keys_[id]); });
             return matching_entries;
         }
 
         /** @brief Add a new entry by tag */
+        void add_to_tag_index_(dbkey_t k, tag_id_t tag) {
+            entries_by_tag_[tag].add(local_id_(k));
+        }
         void add_to_tag_index_(dbkey_t k, string tag) {
-            entries_by_tag_[tag].insert(k);
+            add_to_tag_index_(k, TagDictionary::get().intern(tag));
         }
         template<typename ...Args>
         void add_to_tag_index_(dbkey_t k, string tag, Args && ...args) {
@@ -104,8 +187,15 @@ class SeqDB {
         }
 
         /** @brief Remove an entry by tag */
+        void remove_from_tag_index_(dbkey_t k, tag_id_t tag) {
+            auto it = entries_by_tag_.find(tag);
+            uint32_t id;
+            if (it == entries_by_tag_.end() || !find_local_id_(k, id)) return;
+            it->second.remove(id);
+            if (it->second.empty()) entries_by_tag_.erase(it);
+        }
         void remove_from_tag_index_(dbkey_t k, string tag) {
-            entries_by_tag_[tag].erase(k);
+            remove_from_tag_index_(k, TagDictionary::get().find(tag));
         }
         template<typename ...Args>
         void remove_from_tag_index_(dbkey_t k, string tag, Args && ...args) {
@@ -129,6 +219,31 @@ class SeqDB {
 
         RandomKeyGen random_key_gen_;
 
+        /** @brief Threads to spread thread-safe filters over; with 1, every
+         * filter runs on the processing thread */
+        size_t filter_threads_ = 1;
+
+        /** @brief Only check the entries changed since the last stage */
+        bool incremental_ = false;
+
+        /** @brief Check every entry in the next stage, even when incremental */
+        bool full_scan_ = true;
+
+        /** @brief Entries parked by a filter, with the tag a subscription
+         * will remove to wake them */
+        absl::flat_hash_map<dbkey_t, vector<pair<tag_id_t, filter_p>>> parked_;
+
+        /** @brief Entries woken since the last stage, and the filter that
+         * parked each */
+        vector<pair<dbkey_t, filter_p>> ready_;
+
+        /** @brief The filter running on the processing thread, if any */
+        filter_p running_filter_;
+
+        /** @brief Serializes the retrieval functions filters call, which
+         * may go over the network */
+        recursive_mutex retrieval_mutex_;
+
         void initialize_random_key_gen_() {
             random_key_gen_.initialize_seed(agent_id_);
         }
@@ -152,7 +267,13 @@ class SeqDB {
 
         /** @brief Hold the actual database */
         ParDBThread<PandoMap> db_server_;
-        PandoMapClient db_;
+
+        /** @brief Access the database over ZMQ, or directly in-process */
+        PandoMapClient db_ipc_;
+        PandoMapLocal db_local_;
+
+        /** @brief The database access in use, in-process by default */
+        PandoMapBackend* db_;
 
         /** @brief Hold the install filters */
         absl::flat_hash_map<string, filter_p> installed_filters_;
@@ -160,59 +281,278 @@ class SeqDB {
         /** @brief Hold entries that need their values updates */
         absl::flat_hash_map<dbkey_t, string> val_updates_;
 
+        /** @brief Compact the map at the end of a stage once more than this
+         * fraction of its space is not live; 0 disables compaction */
+        double compact_threshold_ = 0;
+
+        /** @brief A merge operator for every key with (key.a & key_a_mask)
+         * == key_a_value */
+        struct MergeRule {
+            chain_info_t key_a_mask;
+            chain_info_t key_a_value;
+            MergeOp op;
+        };
+        vector<MergeRule> merge_rules_;
+
+        /** @brief Entries created, changed, or woken since filters last
+         * checked them; only kept when incremental */
+        absl::flat_hash_set<dbkey_t> dirty_;
+
+        /** @brief Note that an entry's filters need to be checked again */
+        void mark_dirty_(dbkey_t key) {
+            if (incremental_) dirty_.insert(key);
+        }
+
+        /** @brief Queue the filters parked on an entry until a tag was
+         * removed, returning whether any were */
+        bool wake_(dbkey_t key, const string& tag) {
+            auto it = parked_.find(key);
+            if (it == parked_.end()) return false;
+
+            tag_id_t tag_id = TagDictionary::get().find(tag);
+            bool woken = false;
+            auto & waiting = it->second;
+            for (auto w = waiting.begin(); w != waiting.end(); ) {
+                if (w->first == tag_id) {
+                    ready_.push_back({key, move(w->second)});
+                    w = waiting.erase(w);
+                    woken = true;
+                } else
+                    ++w;
+            }
+            if (waiting.empty()) parked_.erase(it);
+            return woken;
+        }
+
+        /** @brief Note a removed tag; an entry woken by it only needs the
+         * filter that parked it, the rest are checked again */
+        void tag_removed_(dbkey_t key, const string& tag) {
+            if (!wake_(key, tag)) mark_dirty_(key);
+        }
+
+        /** @brief Return the keys of the entries matching a filter predicate
+         *
+         * @param within if given, only consider these entries
+         */
+        vector<dbkey_t> match_predicate_(const FilterPredicate* predicate, const absl::flat_hash_set<dbkey_t>* within = nullptr) {
+            vector<dbkey_t> candidates;
+
+            auto & dict = TagDictionary::get();
+
+            // Every required tag must be indexed, or nothing can match
+            vector<const PostingList*> required;
+            if (predicate->required_tags != nullptr) {
+                for (auto tags = predicate->required_tags; (*tags)[0] != '\0'; ++tags) {
+                    auto it = entries_by_tag_.find(dict.find(*tags));
+                    if (it == entries_by_tag_.end() || it->second.empty())
+                        return candidates;
+                    required.push_back(&it->second);
+                }
+            }
+            sort(required.begin(), required.end(),
+                [](auto a, auto b) { return a->cardinality() < b->cardinality(); });
+
+            vector<const PostingList*> forbidden;
+            if (predicate->forbidden_tags != nullptr) {
+                for (auto tags = predicate->forbidden_tags; (*tags)[0] != '\0'; ++tags) {
+                    auto it = entries_by_tag_.find(dict.find(*tags));
+                    if (it != entries_by_tag_.end() && !it->second.empty())
+                        forbidden.push_back(&it->second);
+                }
+            }
+
+            auto key_matches = [&](const dbkey_t& key) {
+                return (key.a & predicate->key_a_mask) == predicate->key_a_value;
+            };
+
+            if (required.size() == 0 || (within != nullptr && within->size() < required[0]->cardinality())) {
+                // Check the entries one at a time; only the key can narrow
+                // this down without a required tag
+                auto matches = [&](const dbkey_t& key) {
+                    if (!key_matches(key)) return false;
+                    uint32_t id;
+                    if (!find_local_id_(key, id)) return required.size() == 0;
+                    for (auto entries : required)
+                        if (!entries->contains(id)) return false;
+                    for (auto entries : forbidden)
+                        if (entries->contains(id)) return false;
+                    return true;
+                };
+                if (within != nullptr) {
+                    for (auto & key : *within)
+                        if (matches(key)) candidates.push_back(key);
+                } else {
+                    for (auto & key : db_->keys())
+                        if (matches(key)) candidates.push_back(key);
+                }
+            } else {
+                // Intersect the required tags' entries, smallest first, and
+                // take out the forbidden ones
+                PostingList matching = *required[0];
+                for (size_t i = 1; i < required.size() && !matching.empty(); ++i)
+                    matching.intersect_with(*required[i]);
+                for (auto entries : forbidden) {
+                    if (matching.empty()) break;
+                    matching.subtract(*entries);
+                }
+                matching.for_each([&](uint32_t id) {
+                    auto & key = local_keys_[id];
+                    if (key_matches(key) && (within == nullptr || within->count(key) != 0))
+                        candidates.push_back(key);
+                });
+            }
+            // Visit the entries in key order
+            sort(candidates.begin(), candidates.end());
+            return candidates;
+        }
+
         bool run_filters_() {
             bool filter_ran = false;
-            auto keys = db_.keys();
             size_t i = 0;
-            size_t num_keys [[maybe_unused]]  = keys.size(); // unused w/o verbosity
+            size_t num_keys [[maybe_unused]]  = db_->size(); // unused w/o verbosity
 
             // limit how many filters we run before a stage close to help with memory usage
             size_t MAX_FILTERS_TO_RUN = 100000;
             size_t num_filters_run = 0;
 
+            // When incremental, only the entries changed since the last
+            // stage can have a different outcome
+            bool incremental = incremental_ && !full_scan_;
+            absl::flat_hash_set<dbkey_t> dirty;
+            vector<dbkey_t> dirty_keys;
+            if (incremental) {
+                dirty.swap(dirty_);
+                dirty_keys.assign(dirty.begin(), dirty.end());
+                sort(dirty_keys.begin(), dirty_keys.end());
+            }
+            dirty_.clear();
+            full_scan_ = false;
+            const absl::flat_hash_set<dbkey_t>* within = incremental ? &dirty : nullptr;
+
+            // Filters already checked on woken entries this stage
+            absl::flat_hash_set<pair<dbkey_t, const Filter*>> ran_ready;
+
+            auto run_filter = [&](filter_p& filter, const DBAccess& entry_access) {
+                if (!ran_ready.empty() && ran_ready.count({entry_access.key, filter.get()}) != 0)
+                    return;
+
+                // Each filter gets its own copy of the access, since the DB
+                // access functions point back into it
+                DBAccess access = entry_access;
+                add_db_access(&access);
+
+                if (filter->should_run(&access)) {
+                    filter_ran = true;
+                    running_filter_ = filter;
+                    filter->run(&access);
+                    running_filter_ = nullptr;
+                    ++num_filters_run;
+                }
+            };
+
+            // Entries woken by a subscription go straight to the filter
+            // that parked them, if it is still installed
+            vector<pair<dbkey_t, filter_p>> ready;
+            ready.swap(ready_);
+            for (auto & [key, filter] : ready) {
+                auto installed = installed_filters_.find(filter->name());
+                if (installed == installed_filters_.end() || installed->second != filter)
+                    continue;
+                db_->visit(key, [&](const DBAccess& entry_access) {
+                    run_filter(filter, entry_access);
+                });
+                ran_ready.insert({key, filter.get()});
+            }
 
-            // Iterate through the database
-            for (auto & key : keys) {         // TODO : replace this with a C++ iterator that automatically "batches" behind the scene
-                auto entry = db_.retrieve(key); //TODO also batch retrievals
+            // Thread-safe filters go to worker threads, as long as the map
+            // is read in-process
+            bool parallel = filter_threads_ > 1 && db_ == &db_local_;
+            vector<FilterJob> parallel_jobs;
+            FilterJob parallel_scan;
+
+            // Filters with a predicate only look at their candidate entries,
+            // found through the tag index; the rest check every entry
+            vector<filter_p> scan_filters;
+            for (auto & [filter_name, filter] : installed_filters_) {
+                // Only run on filters that are SINGLE_ENTRY filters
+                if (filter->filter_type() != SINGLE_ENTRY) {
+                    continue;
+                }
+
+                auto predicate = filter->predicate();
+                if (parallel && filter->thread_safe()) {
+                    if (predicate == nullptr)
+                        parallel_scan.filters.push_back(filter);
+                    else
+                        parallel_jobs.push_back({{filter}, match_predicate_(predicate, within)});
+                    continue;
+                }
+                if (predicate == nullptr) {
+                    scan_filters.push_back(filter);
+                    continue;
+                }
+
+                for (auto & key : match_predicate_(predicate, within)) {
+                    if (num_filters_run > MAX_FILTERS_TO_RUN) break;
+                    db_->visit(key, [&](const DBAccess& entry_access) {
+                        run_filter(filter, entry_access);
+                    });
+                }
+            }
+
+            auto scan_entry = [&](const DBAccess& entry_access) {
                 ++i;
                 #ifdef VERBOSE
                 if (i % 10000 == 0) {
                     cerr << "I have processed " << i << "/" <<  num_keys << " entries and run " << num_filters_run << " filters"  << endl;
                 }
                 #endif
-                // @TODO profile to determine if this needs to be optimized out.
-                //       this costs (|F|*|E|)
-                for (auto & [filter_name, filter] : installed_filters_) {
-                    // Only run on filters that are SINGLE_ENTRY filters
-                    if (filter->filter_type() != SINGLE_ENTRY) {
-                        continue;
-                    }
-
-                    // @TODO move back out; make a test for add tags and then
-                    // get tags inside of a filter
-                    // Get the DB access -- need to redo this for each filter,
-                    // can't be pulled out of the loop because things can
-                    // change between filter runs
-                    DBAccess* access = entry.access();
-                    add_db_access(access);
-
-                    if (filter->should_run(access)) {
-                        filter_ran = true;
-                        filter->run(access);
-                        ++num_filters_run;
-                    }
-
-                    delete access;
+                for (auto & filter : scan_filters) {
+                    run_filter(filter, entry_access);
                 }
 
                 if (num_filters_run > MAX_FILTERS_TO_RUN) {
                     #ifdef VERBOSE
                     cerr << "breaking early due to max filter run limit" << endl;
                     #endif
-                    break;
+                    return false;
+                }
+                return true;
+            };
+
+            if (scan_filters.size() > 0 && num_filters_run <= MAX_FILTERS_TO_RUN) {
+                if (incremental) {
+                    for (auto & key : dirty_keys) {
+                        bool keep_going = true;
+                        db_->visit(key, [&](const DBAccess& entry_access) {
+                            keep_going = scan_entry(entry_access);
+                        });
+                        if (!keep_going) break;
+                    }
+                } else {
+                    // Iterate through the database, which is batched behind the scenes
+                    db_->scan(scan_entry);
                 }
             }
 
+            if (parallel_scan.filters.size() > 0) {
+                parallel_scan.keys = incremental ? move(dirty_keys) : db_->keys();
+                parallel_jobs.push_back(move(parallel_scan));
+            }
+            if (parallel_jobs.size() > 0 && num_filters_run <= MAX_FILTERS_TO_RUN) {
+                size_t runs = run_filters_parallel_(parallel_jobs, MAX_FILTERS_TO_RUN-num_filters_run, ran_ready);
+                if (runs > 0) filter_ran = true;
+                num_filters_run += runs;
+            }
+
+            // Entries skipped by stopping early must be checked next stage
+            if (incremental_ && num_filters_run > MAX_FILTERS_TO_RUN) {
+                if (incremental)
+                    dirty_.insert(dirty.begin(), dirty.end());
+                else
+                    full_scan_ = true;
+            }
+
             #ifdef VERBOSE
             cerr << "done processing" << endl;
             #endif
@@ -220,6 +560,127 @@ class SeqDB {
             return filter_ran;
         }
 
+        /** @brief Filters to run over a list of entries */
+        struct FilterJob {
+            vector<filter_p> filters;
+            vector<dbkey_t> keys;
+        };
+
+        /** @brief Entries a worker claims at a time */
+        constexpr static size_t FILTER_CHUNK_SIZE = 256;
+
+        /** @brief Run thread-safe filters on filter_threads_ threads
+         *
+         * Workers claim chunks of entries until none are left, so a few slow
+         * entries do not hold up the rest.  The changes the filters make are
+         * staged per worker and applied on this thread once all are done.
+         *
+         * @param max_runs stop claiming chunks after this many filter runs
+         * @param skip entries and filters already checked this stage
+         * @return the number of filters that ran
+         */
+        size_t run_filters_parallel_(const vector<FilterJob>& jobs, size_t max_runs,
+                const absl::flat_hash_set<pair<dbkey_t, const Filter*>>& skip) {
+            struct Chunk {
+                const FilterJob* job;
+                size_t begin, end;
+            };
+            vector<Chunk> chunks;
+            for (auto & job : jobs) {
+                for (size_t begin = 0; begin < job.keys.size(); begin += FILTER_CHUNK_SIZE)
+                    chunks.push_back({&job, begin, min(job.keys.size(), begin+FILTER_CHUNK_SIZE)});
+            }
+
+            atomic<size_t> next_chunk {0};
+            atomic<size_t> num_filters_run {0};
+
+            size_t num_threads = min(filter_threads_, chunks.size());
+            vector<StagedFilterOps> staged(num_threads);
+            vector<exception_ptr> errors(num_threads);
+            vector<thread> threads;
+            for (size_t t = 0; t < num_threads; ++t) {
+                threads.emplace_back([&, t]() {
+                    try {
+                        for (size_t c = next_chunk++; c < chunks.size() && num_filters_run <= max_runs; c = next_chunk++) {
+                            auto & chunk = chunks[c];
+                            for (size_t i = chunk.begin; i < chunk.end; ++i) {
+                                db_->visit(chunk.job->keys[i], [&](const DBAccess& entry_access) {
+                                    for (auto & filter : chunk.job->filters) {
+                                        if (!skip.empty() && skip.count({entry_access.key, filter.get()}) != 0)
+                                            continue;
+
+                                        DBAccess access = entry_access;
+                                        add_db_access_staged_(&access, &staged[t]);
+
+                                        if (filter->should_run(&access)) {
+                                            staged[t].filter = filter;
+                                            filter->run(&access);
+                                            ++num_filters_run;
+                                        }
+                                    }
+                                });
+                            }
+                        }
+                    } catch (...) {
+                        errors[t] = current_exception();
+                    }
+                });
+            }
+            for (auto & th : threads) th.join();
+            for (auto & error : errors)
+                if (error) rethrow_exception(error);
+
+            for (auto & worker_ops : staged)
+                apply_staged_ops_(worker_ops);
+
+            return num_filters_run;
+        }
+
+        /** @brief Point a worker's DB access at its staged changes */
+        void add_db_access_staged_(DBAccess* access, StagedFilterOps* ops) {
+            access->make_new_entry.state = ops;
+            access->make_new_entry.run = &s_SeqDB_staged_new_entry;
+
+            access->add_tag.state = access;
+            access->add_tag.run = &s_SeqDB_staged_add_tag;
+
+            access->remove_tag.state = access;
+            access->remove_tag.run = &s_SeqDB_staged_remove_tag;
+
+            access->subscribe_to_entry.state = access;
+            access->subscribe_to_entry.run = &s_SeqDB_staged_subscribe_to_entry;
+
+            access->update_entry_val.state = access;
+            access->update_entry_val.run = &s_SeqDB_staged_update_entry_val;
+
+            add_db_access_ret(access);
+        }
+
+        /** @brief Make the changes staged by a worker, in order */
+        void apply_staged_ops_(StagedFilterOps& staged) {
+            for (auto & op : staged.ops) {
+                switch (op.kind) {
+                    case StagedFilterOps::NEW_ENTRY:
+                        stage_add_entry(move(op.entry));
+                        break;
+                    case StagedFilterOps::ADD_TAG:
+                        stage_add_tag(op.key, move(op.arg));
+                        break;
+                    case StagedFilterOps::REMOVE_TAG:
+                        stage_remove_tag(op.key, move(op.arg));
+                        break;
+                    case StagedFilterOps::SET_VALUE:
+                        stage_update_entry_val(op.key, move(op.arg));
+                        break;
+                    case StagedFilterOps::SUBSCRIBE:
+                        if (op.filter) park(op.key, op.arg, move(op.filter));
+                        subscribe_to_entry_wrapper(op.key, op.wait_key, move(op.arg));
+                        break;
+                }
+            }
+            staged.ops.clear();
+        }
+
 
     public:
 
@@ -227,23 +688,27 @@ class SeqDB {
          * NOTE: localhost IP addresses used as default values for test cases
          * */
         SeqDB() : db_server_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}),
-            db_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, ZMQAddress {"127.0.0.1", 0}) { Py_Initialize(); }
+            db_ipc_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, ZMQAddress {"127.0.0.1", 0}),
+            db_local_(db_server_.get()), db_(&db_local_) { Py_Initialize(); }
 
         /** @brief Create a database with an agent id to use as seed */
-        SeqDB(ZMQAddress addr) : db_server_(addr+MAP_LOCALNUM_OFFSET), db_(addr+MAP_LOCALNUM_OFFSET, addr) {
+        SeqDB(ZMQAddress addr) : db_server_(addr+MAP_LOCALNUM_OFFSET), db_ipc_(addr+MAP_LOCALNUM_OFFSET, addr),
+                db_local_(db_server_.get()), db_(&db_local_) {
             set_agent_id(addr.serialize());
             Py_Initialize();
         }
 
         /** @brief Create a database with an agent id to use as seed and allocator size*/
-        SeqDB(ZMQAddress addr, size_t size) : db_server_(addr+MAP_LOCALNUM_OFFSET, size), db_(addr+MAP_LOCALNUM_OFFSET, addr) {
+        SeqDB(ZMQAddress addr, size_t size) : db_server_(addr+MAP_LOCALNUM_OFFSET, size), db_ipc_(addr+MAP_LOCALNUM_OFFSET, addr),
+                db_local_(db_server_.get()), db_(&db_local_) {
             set_agent_id(addr.serialize());
             Py_Initialize();
         }
 
         /** @brief Build a SeqDB from an input file */
         SeqDB(string fn) : db_server_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}),
-                db_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, ZMQAddress {"127.0.0.1", 0}) {
+                db_ipc_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, ZMQAddress {"127.0.0.1", 0}),
+                db_local_(db_server_.get()), db_(&db_local_) {
             add_db_file(fn);
 
             Py_Initialize();
@@ -255,7 +720,8 @@ class SeqDB {
 
         /** @brief Build a SeqDB from an input file with a DB size */
         SeqDB(string fn, size_t size) : db_server_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, size),
-                                        db_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, ZMQAddress {"127.0.0.1", 0}) {
+                                        db_ipc_(ZMQAddress {"127.0.0.1", 0+MAP_LOCALNUM_OFFSET}, ZMQAddress {"127.0.0.1", 0}),
+                                        db_local_(db_server_.get()), db_(&db_local_) {
             add_db_file(fn);
             Py_Initialize();
         }
@@ -329,6 +795,110 @@ class SeqDB {
                 cerr << "Unable to open test file, skipping" << endl;
         }
 
+        /** @brief Select whether the database is accessed over ZMQ (true) or
+         * directly in-process (false, the default)
+         *
+         * Both access the same PandoMap, so this can be changed at any time
+         */
+        void use_ipc_map(bool use_ipc) {
+            if (use_ipc)
+                db_ = &db_ipc_;
+            else
+                db_ = &db_local_;
+        }
+
+        /** @brief Run thread-safe filters on this many threads */
+        void set_filter_threads(size_t num_threads) {
+            filter_threads_ = max<size_t>(num_threads, 1);
+        }
+
+        /** @brief Only check the entries created, changed, or woken since
+         * the last stage, rather than every entry
+         *
+         * Filters whose outcome depends on other entries should subscribe to
+         * them, or the entry will not be checked again once they change.
+         * The first stage after enabling this, or after installing a
+         * filter, still checks every entry.
+         */
+        void set_incremental(bool incremental) {
+            if (incremental && !incremental_) full_scan_ = true;
+            incremental_ = incremental;
+            if (!incremental_) dirty_.clear();
+        }
+
+        /** @brief Check every entry in the next stage */
+        void request_full_scan() {
+            full_scan_ = true;
+        }
+
+        /** @brief Merge entries in a key family as if they had a merge
+         * strategy tag
+         *
+         * The family is every key with (key.a & key_a_mask) == key_a_value,
+         * as in a filter predicate.  An entry's own MERGE_STRATEGY= tag still
+         * takes precedence.  Any other strategy tag, such as
+         * MERGE_STRATEGY=FORCE_MERGE, removes the family's rule.
+         */
+        void set_merge_strategy(chain_info_t key_a_mask, chain_info_t key_a_value, const string& strategy) {
+            MergeOp op = merge_op_from_tag(strategy.c_str());
+            merge_rules_.erase(remove_if(merge_rules_.begin(), merge_rules_.end(), [&](const MergeRule& r) {
+                return r.key_a_mask == key_a_mask && r.key_a_value == key_a_value;
+            }), merge_rules_.end());
+            if (op != MergeOp::NONE)
+                merge_rules_.push_back({key_a_mask, key_a_value, op});
+        }
+
+        /** @brief Return the operator merging an entry, from its tags or
+         * else its key family */
+        MergeOp merge_op(const DBEntry<>& entry) const {
+            for (auto tags = entry.c_tags(); (*tags)[0] != '\0'; ++tags) {
+                MergeOp op = merge_op_from_tag(*tags);
+                if (op != MergeOp::NONE) return op;
+            }
+            dbkey_t key = entry.get_key();
+            for (auto & rule : merge_rules_)
+                if ((key.a & rule.key_a_mask) == rule.key_a_value) return rule.op;
+            return MergeOp::NONE;
+        }
+
+        /** @brief Run a filter on an entry in the stage after a tag is
+         * removed from it, rather than waiting for it to be scanned */
+        void park(dbkey_t key, const string& tag, filter_p filter) {
+            parked_[key].push_back({TagDictionary::get().intern(tag), move(filter)});
+        }
+
+        /** @brief Return whether woken entries are waiting for a stage */
+        bool has_ready() const { return !ready_.empty(); }
+
+        /** @brief Return the filter running on the processing thread */
+        const filter_p& running_filter() const { return running_filter_; }
+
+        /** @brief Hold while calling a retrieval function for a filter */
+        unique_lock<recursive_mutex> retrieval_lock() {
+            return unique_lock(retrieval_mutex_);
+        }
+
+        /** @brief Compact the map at the end of any stage that leaves more
+         * than the given fraction of the map's space unused (0 disables) */
+        void set_compact_threshold(double threshold) {
+            compact_threshold_ = threshold;
+        }
+
+        /** @brief Copy the entries into a fresh space if enough of the
+         * current one is fragmented; returns whether it was compacted */
+        bool compact_if_fragmented() {
+            if (compact_threshold_ <= 0) return false;
+
+            auto & map = db_server_.get();
+            auto lock = map.write_lock();
+            auto & space = map.space();
+            if (space.fragmented() <= compact_threshold_*space.used())
+                return false;
+
+            map.compact();
+            return true;
+        }
+
         virtual void subscribe_to_entry_wrapper(dbkey_t my_key, dbkey_t wait_key, string inactive_tag) {
             subscribe_to_entry(my_key, wait_key, inactive_tag);
         }
@@ -355,68 +925,97 @@ class SeqDB {
             }
 
             dbkey_t key = entry->get_key();
-            for (auto &tag : entry->tags()) {
-                add_to_tag_index_(key, tag);
-            }
             handle_subscriptions(key);
+            mark_dirty_(key);
 
-            //If the key already exists, we concatenate the entries' values and tags
-            auto [e, exists] = db_.retrieve_if_exists(entry->get_key());
+            //If the key already exists, we merge the entries' values and tags
+            auto [e, exists] = db_->retrieve_if_exists(entry->get_key());
             if (exists) {
+                merge_entries(&e, entry);
 
-                // if the entries are different, or if either entry has the
-                // "MERGE_STRATEGY=FORCE_MERGE" tag, then concatenate them
-                bool should_concat = e != *entry;
-                bool force_merge = e.has_tag(MERGE_STRATEGY_FORCE);
-                force_merge |= entry->has_tag(MERGE_STRATEGY_FORCE);
-                should_concat |= force_merge;
-
-                if (e.has_tag(MERGE_STRATEGY_SUM)) {
-                    should_concat = false;
-                    *entry = sum_entries(&e, entry);
+                // Drop index entries for tags the stored entry is losing
+                for (tag_id_t tag : e.tag_ids()) {
+                    if (!entry->has_tag_id(tag))
+                        remove_from_tag_index_(key, tag);
                 }
+            } else if (merge_op(*entry) == MergeOp::COUNT && !entry->has_tag(merged_tag(MergeOp::COUNT))) {
+                // A counted entry is stored as its count
+                entry->value() = "1";
+                entry->add_tag(merged_tag(MergeOp::COUNT));
+            }
 
-                if (should_concat)
-                    *entry = concat_entries(&e, entry, force_merge);
+            // Index the tags of the entry as it will be stored
+            for (tag_id_t tag : entry->tag_ids()) {
+                add_to_tag_index_(key, tag);
             }
         }
 
         /** @brief Add a specific DB entry */
         void add_entry_worker(DBEntry<> entry) {
             prepare_to_add_entry(&entry);
-            db_.insert(move(entry));
+            db_->insert(move(entry));
         }
 
         void add_entries(absl::flat_hash_map<dbkey_t, DBEntry<>>* entries) {
             for (auto & [key, entry] : *entries) {
                 prepare_to_add_entry(&entry);
             }
-            db_.insert_multiple(entries);
+            db_->insert_multiple(entries);
         }
 
-        DBEntry<> sum_entries(DBEntry<>* e1, DBEntry<>* e2) {
-            DBEntry<> new_entry;
-            new_entry.set_key(e1->get_key());
-            vector<string> tag_union;
-            auto e1_tags = e1->tags();
-            auto e2_tags = e2->tags();
-            set_union(e1_tags.begin(), e1_tags.end(), e2_tags.begin(), e2_tags.end(), inserter(tag_union, tag_union.begin()));
-
-            for (auto &tag : tag_union) {
-                new_entry.add_tag(tag);
-            }
-
-            try {
-                double num1 = boost::lexical_cast<double>(e1->value());
-                double num2 = boost::lexical_cast<double>(e2->value());
-                double sum = num1 + num2;
-                new_entry.value() = to_string(sum);
-                new_entry.add_tag("MERGED_SUM");
-            } catch (const boost::bad_lexical_cast& exc) {
-                DBEntry<> new_concat_entry = concat_entries(e1, e2).add_tag("MERGED_SUM_FAILED");
+        /** @brief Merge an entry added at the key of an existing entry
+         * into it
+         *
+         * With a merge operator, from either entry or the key family, the
+         * values are combined by the operator.  Otherwise different entries
+         * are concatenated, and an identical entry leaves added as it is.
+         *
+         * @param e the existing entry
+         * @param added the added entry, replaced by the merged entry
+         */
+        void merge_entries(DBEntry<>* e, DBEntry<>* added) {
+            MergeOp op = merge_op(*e);
+            if (op == MergeOp::NONE) op = merge_op(*added);
+
+            if (op == MergeOp::APPEND) {
+                *added = concat_entries(e, added);
+            } else if (op != MergeOp::NONE) {
+                *added = apply_merge_op(op, e, added);
+            } else {
+                // if the entries are different, or if either entry has the
+                // "MERGE_STRATEGY=FORCE_MERGE" tag, then concatenate them
+                bool force_merge = e->has_tag(MERGE_STRATEGY_FORCE);
+                force_merge |= added->has_tag(MERGE_STRATEGY_FORCE);
+                if (*e != *added || force_merge)
+                    *added = concat_entries(e, added, force_merge);
+            }
+        }
+
+        /** @brief Combine two entries' values with a numeric merge operator
+         *
+         * Falls back to concatenating them, tagged MERGED_<op>_FAILED, if
+         * either value is not a number.
+         */
+        DBEntry<> apply_merge_op(MergeOp op, DBEntry<>* e1, DBEntry<>* e2) {
+            // An entry not yet counted counts once
+            auto read = [&](DBEntry<>* e) {
+                if (op == MergeOp::COUNT && !e->has_tag(merged_tag(op)))
+                    return TypedValue {(int64_t)1};
+                return TypedValue::parse(e->value());
+            };
+
+            TypedValue merged;
+            if (!merge_numbers(op, read(e1), read(e2), merged)) {
+                DBEntry<> new_concat_entry = concat_entries(e1, e2).add_tag(string(merged_tag(op)) + "_FAILED");
                 new_concat_entry.set_key(e1->get_key());
                 return new_concat_entry;
             }
+
+            DBEntry<> new_entry;
+            new_entry.set_key(e1->get_key());
+            new_entry.merge_tags(*e1).merge_tags(*e2);
+            new_entry.value() = merged.str();
+            new_entry.add_tag(merged_tag(op));
             return new_entry;
         }
 
@@ -431,20 +1030,11 @@ class SeqDB {
             dbkey_t new_key = e1->get_key();
             new_entry.set_key(new_key);
 
-            vector<string> tag_union;
-            if (force_merge) {
-                // if we are force merging, assume they have the same tags TODO is this okay? It might be an optimization
-                auto & e1_tags = e1->tags();
-                tag_union.assign(e1_tags.begin(), e1_tags.end());
-            } else {
-                auto e1_tags = e1->tags();
-                auto e2_tags = e2->tags();
-                set_union(e1_tags.begin(), e1_tags.end(), e2_tags.begin(), e2_tags.end(), inserter(tag_union, tag_union.begin()));
-            }
-            tag_union.push_back("MERGED");
-            for (auto &tag : tag_union) {
-                new_entry.add_tag(tag);
-            }
+            // if we are force merging, assume they have the same tags TODO is this okay? It might be an optimization
+            new_entry.merge_tags(*e1);
+            if (!force_merge)
+                new_entry.merge_tags(*e2);
+            new_entry.add_tag("MERGED");
 
             return new_entry;
         }
@@ -459,21 +1049,11 @@ class SeqDB {
                 entry.set_key(generate_random_key());
             }
 
-            //If the key already exists, we concatenate the entries' values and tags
+            //If the key already exists, we merge the entries' values and tags
             auto new_entries_it = new_entries_.find(entry.get_key());
             if (new_entries_it != new_entries_.end()) {
-
-                // if the entries are different, or if either entry has the
-                // "MERGE_STRATEGY=FORCE_MERGE" tag, then concatenate them
-                bool should_concat = new_entries_it->second != entry;
-                bool force_merge = entry.has_tag(MERGE_STRATEGY_FORCE);
-                force_merge |= new_entries_it->second.has_tag(MERGE_STRATEGY_FORCE);
-                should_concat |= force_merge;
-
-                if (should_concat) {
-                    entry = concat_entries(&(new_entries_it->second), &entry, force_merge);
-                    new_entries_it->second = move(entry);
-                }
+                merge_entries(&(new_entries_it->second), &entry);
+                new_entries_it->second = move(entry);
             } else
                 new_entries_.insert({entry.get_key(), move(entry)});
         }
@@ -501,20 +1081,34 @@ class SeqDB {
             add_entries(&new_entries_);
             new_entries_.clear();
 
+            // Apply the remaining changes where the entries are stored, in a
+            // single batch
             //TODO test case, what if key doesn't exist?
-            if (val_updates_.size() != 0) {
-                for (auto & [key, new_val] : val_updates_) {
-                    update_entry_val(key, new_val);
-                }
+            vector<MapModification> mods;
+            mods.reserve(val_updates_.size()+tags_to_add_.size()+tags_to_remove_.size());
+            for (auto & [key, new_val] : val_updates_) {
+                mods.emplace_back(MapModification::SET_VALUE, key, move(new_val));
+                mark_dirty_(key);
             }
             val_updates_.clear();
 
-            add_tags_to_entries(&tags_to_add_);
+            for (auto & [key, tag] : tags_to_add_) {
+                mods.emplace_back(MapModification::ADD_TAG, key, tag);
+                add_to_tag_index_(key, tag);
+                mark_dirty_(key);
+            }
             tags_to_add_.clear();
 
-            for (auto & [key, tag] : tags_to_remove_)
-                remove_tag_from_entry(key, tag);
+            for (auto & [key, tag] : tags_to_remove_) {
+                mods.emplace_back(MapModification::REMOVE_TAG, key, tag);
+                remove_from_tag_index_(key, tag);
+                tag_removed_(key, tag);
+            }
             tags_to_remove_.clear();
+
+            db_->modify_multiple(mods);
+
+            compact_if_fragmented();
         }
 
         virtual void stage_update_entry_val(dbkey_t key, string new_val) {
@@ -579,6 +1173,8 @@ class SeqDB {
             string filter_name { filter->name() };
             // Add it to the installed list
             installed_filters_[filter_name] = filter;
+            // Entries the new filter has not seen may match it
+            full_scan_ = true;
         }
 
         /** @brief Return the number of installed filters*/
@@ -608,22 +1204,23 @@ class SeqDB {
 
         /** @brief Process the database, applying filters as appropriate */
         virtual bool process() {
-            while (process_once()) {}
+            // Entries woken as the last stage closed still need a stage
+            while (process_once() || has_ready()) {}
             return false;
         }
 
         /** @brief Return the current size of the database */
-        size_t size() { return db_.size(); }
+        size_t size() { return db_->size(); }
 
         vector<dbkey_t> keys() {
-            return db_.keys();
+            return db_->keys();
         }
 
         /** @brief Return the database entries */
         absl::flat_hash_map<dbkey_t, DBEntry<>> entries() {
             absl::flat_hash_map<dbkey_t, DBEntry<>> entries;
-            for (auto& key : db_.keys()) {
-                entries[key] = db_.retrieve(key);
+            for (auto& key : db_->keys()) {
+                entries[key] = db_->retrieve(key);
             }
             return entries;
         }
@@ -654,6 +1251,9 @@ class SeqDB {
             access->get_entry_by_key.state = this;
             access->get_entry_by_key.run = &s_SeqDB_get_entry_by_key;
 
+            access->get_entries_by_keys.state = this;
+            access->get_entries_by_keys.run = &s_SeqDB_get_entries_by_keys;
+
             access->get_entries_by_tags.state = this;
             access->get_entries_by_tags.run = &s_SeqDB_get_entries_by_tags;
         }
@@ -665,51 +1265,41 @@ class SeqDB {
         }
 
         void add_tags_to_entries(vector<pair<dbkey_t, string>>* to_add) {
-            absl::flat_hash_map<dbkey_t, DBEntry<>> to_insert;
+            vector<MapModification> mods;
+            mods.reserve(to_add->size());
             for (auto & [key, tag] : *to_add) {
-                auto idx = to_insert.find(key);
-                if (idx == to_insert.end()) {
-                    //haven't retrieved this entry yet, retrieve it
-                    auto entry = db_.retrieve(key); //TODO also batch retrievals
-                    entry.add_tag(tag);
-                    to_insert[key] = move(entry);
-                    add_to_tag_index_(key, tag);
-                } else {
-                    idx->second.add_tag(tag);
-                    add_to_tag_index_(key, tag);
-                }
+                mods.emplace_back(MapModification::ADD_TAG, key, tag);
+                add_to_tag_index_(key, tag);
+                mark_dirty_(key);
             }
 
-            db_.insert_multiple(&to_insert);
+            db_->modify_multiple(mods);
         }
 
         /** @brief Add tags to an entry in the database at the given key */
         template<typename ...Args>
         void add_tag_to_entry(dbkey_t k, Args && ...args) {
-            // Add the tags appropriately
-            DBEntry<> e = db_.retrieve(k);
-            e.add_tag(args...);
-            db_.insert(move(e));
+            // Add the tags where the entry is stored
+            db_->add_tags(k, {string(args)...});
             // Update the tag index
             add_to_tag_index_(k, args...);
+            mark_dirty_(k);
         }
 
         /** @brief Remove tags from an entry in the database at the given key */
         template<typename ...Args>
         void remove_tag_from_entry(dbkey_t k, Args && ...args) {
-            // Remove the tags appropriately
-            DBEntry<> e = db_.retrieve(k);
-            e.remove_tag(args...);
-            db_.insert(move(e));
+            // Remove the tags where the entry is stored
+            db_->remove_tags(k, {string(args)...});
             // Update the tag index
             remove_from_tag_index_(k, args...);
+            (tag_removed_(k, args), ...);
         }
 
         /** @brief Update the value of an entry at the given key */
         void update_entry_val(dbkey_t k, string val) {
-            DBEntry<> e = db_.retrieve(k);
-            e.value() = val;
-            db_.insert(move(e));
+            db_->set_value(k, val);
+            mark_dirty_(k);
         }
 
         /** @brief Return an entry based on given C tags
@@ -728,7 +1318,7 @@ class SeqDB {
 
             if (matching_entries.size() == 0) return;
 
-            DBEntry<> entry = db_.retrieve(*matching_entries.begin());
+            DBEntry<> entry = db_->retrieve(*matching_entries.begin());
 
             // This is the first entry to match
             // Return its value
@@ -742,7 +1332,7 @@ class SeqDB {
         void get_entry_value_by_key_worker(dbkey_t search_key, char **res) {
             *res = nullptr;
 
-            auto [entry, exists] = db_.retrieve_if_exists(search_key);
+            auto [entry, exists] = db_->retrieve_if_exists(search_key);
             if (!exists) return;
 
             auto & value = entry.value();
@@ -756,14 +1346,23 @@ class SeqDB {
             get_entry_value_by_key_worker(search_key, res);
         }
 
+        /** @brief Get the values of the entries with the given keys
+         *
+         * res[i] is set as get_entry_value_by_key would set it for keys[i]
+         */
+        virtual void get_entry_values_by_keys(size_t num_keys, const dbkey_t* keys, char **res) {
+            for (size_t i = 0; i < num_keys; ++i)
+                get_entry_value_by_key_worker(keys[i], &res[i]);
+        }
+
 
         /** @brief Remove a tag from an entry found by tags */
         void remove_tag_from_entry(const char* const* search_tags, string tag) {
             auto matching_entries = get_entry_by_tags_(search_tags);
             auto key = *matching_entries.begin();
-            DBEntry<> e = db_.retrieve(key);
-            e.remove_tag(tag);
-            db_.insert(move(e));
+            db_->remove_tags(key, {tag});
+            remove_from_tag_index_(key, tag);
+            tag_removed_(key, tag);
         }
 
         /** @brief Get all entries with the given tags and that return success given a query function */
@@ -771,7 +1370,7 @@ class SeqDB {
             vector<string> ret;
             auto keys = get_entry_by_tags_(c_tags);
             for (auto& key : keys) {
-                DBEntry<> e = db_.retrieve(key);
+                DBEntry<> e = db_->retrieve(key);
                 if (query_func((dbkey_t)key, e.value().c_str(), e.c_tags(), access)) {
                     ret.push_back(string{e.value()});
                 }
@@ -790,6 +1389,31 @@ class SeqDB {
             return get_entry_by_tags_(e.c_tags());
         }
 
+        /** @brief Return how many entries have all of the given tags */
+        size_t count_entries_by_tags(const vector<string>& tags) {
+            PostingList matching;
+            if (!intersect_tags_(tags, matching)) return 0;
+            return matching.cardinality();
+        }
+
+        /** @brief Aggregate the values of the entries with all of the tags
+         *
+         * @param group_by how entries are grouped (see aggregate_group)
+         */
+        aggregates_t aggregate(const vector<string>& tags, const string& group_by) {
+            aggregates_t aggs;
+            PostingList matching;
+            if (!intersect_tags_(tags, matching)) return aggs;
+
+            string group;
+            matching.for_each([&](uint32_t id) {
+                DBEntry<> e = db_->retrieve(local_keys_[id]);
+                if (aggregate_group(group_by, e.get_key(), e.c_tags(), group))
+                    aggs[group].add(e.value().c_str());
+            });
+            return aggs;
+        }
+
         vector<dbkey_t> query(vector<string> tags) {
             set<string> tags_set (tags.begin(), tags.end());
             set<dbkey_t> keys = get_entry_by_tags(tags_set);
@@ -797,6 +1421,34 @@ class SeqDB {
             return ret;
         }
 
+        /** @brief Fill a page of query results, starting at keys[pos]
+         *
+         * The page ends after max_entries entries, or once its entries
+         * reach max_bytes serialized, but always holds at least one entry
+         * if any remain.  Keys no longer in the DB are skipped.
+         *
+         * @param fields which of QUERY_TAGS and QUERY_VALUE to keep
+         * @param value_prefix the most bytes of each value to keep
+         * @return the position of the first key not yet returned
+         */
+        size_t query_page(const vector<dbkey_t>& keys, size_t pos, size_t max_entries, size_t max_bytes,
+                uint8_t fields, size_t value_prefix, vector<DBEntry<>>& page) {
+            size_t page_bytes = 0;
+            for (; pos < keys.size() && page.size() < max_entries; ++pos) {
+                if (!page.empty() && page_bytes >= max_bytes) break;
+
+                auto [entry, exists] = db_->retrieve_if_exists(keys[pos]);
+                if (!exists) continue;
+                if (!(fields & QUERY_TAGS)) entry.set_tag_ids({});
+                if (!(fields & QUERY_VALUE)) entry.set_value("");
+                else if (entry.value().size() > value_prefix) entry.value().resize(value_prefix);
+
+                page_bytes += sizeof(size_t) + entry.serialize_compact_size();
+                page.push_back(move(entry));
+            }
+            return pos;
+        }
+
         dbkey_t generate_random_key() {
             return random_key_gen_.get();
         }
@@ -811,34 +1463,40 @@ class SeqDB {
         }
 
         vector<dbkey_t> get_keys() {
-            return db_.keys();
+            return db_->keys();
         }
 
         size_t serialize_size(vector<dbkey_t> key_list) {
             size_t ser_size = 0;
             ser_size += sizeof(size_t);
+            ser_size += sizeof(size_t);
+            absl::flat_hash_set<tag_id_t> tag_ids;
             for (auto & key : key_list) {
-                DBEntry<> entry = db_.retrieve(key);
-                size_t entry_size = entry.serialize_size();
+                DBEntry<> entry = db_->retrieve(key);
+                size_t entry_size = entry.serialize_compact_size();
                 ser_size += sizeof(size_t);
                 ser_size += entry_size;
+                tag_ids.insert(entry.tag_ids().begin(), entry.tag_ids().end());
             }
+            ser_size += dictionary_size_(tag_ids);
 
             return ser_size;
         }
 
 		size_t serialize_size() {
-            return serialize_size(db_.keys());
+            return serialize_size(db_->keys());
         }
 
         //serialize format:
         //<num_entries (size_t)>
+        //<size of the entries (size_t)>
         //  <size of entry (size_t)>
-        //  <entry data (variable length)>
+        //  <compact entry data (variable length)>
         //  <size of entry (size_t)>
-        //  <entry data (variable length)>
+        //  <compact entry data (variable length)>
+        //<tag dictionary for the entries' tag ids>
         void serialize_entries(char*& ser_ptr) {
-            serialize_entries(ser_ptr, db_.keys());
+            serialize_entries(ser_ptr, db_->keys());
             return;
         }
 
@@ -849,28 +1507,116 @@ class SeqDB {
             size_t num_entries = key_list.size();
             *(size_t*)ser_ptr = num_entries; ser_ptr += sizeof(size_t);
 
+            //leave room for the size of the entries, so the dictionary
+            //after them can be found
+            size_t* entries_size = (size_t*)ser_ptr; ser_ptr += sizeof(size_t);
+            const char* entries_start = ser_ptr;
+
+            absl::flat_hash_set<tag_id_t> tag_ids;
             for (auto & key : key_list) {
-                DBEntry<> entry = db_.retrieve(key);
+                DBEntry<> entry = db_->retrieve(key);
                 //before each entry, write a size_t of how big the entry is
-                size_t ser_size = entry.serialize_size();
+                size_t ser_size = entry.serialize_compact_size();
                 *(size_t*)ser_ptr = ser_size; ser_ptr += sizeof(size_t);
                 //Write the actual entry data
-                entry.serialize(ser_ptr);
+                entry.serialize_compact(ser_ptr);
+                tag_ids.insert(entry.tag_ids().begin(), entry.tag_ids().end());
             }
+            *entries_size = ser_ptr - entries_start;
 
+            serialize_dictionary_(ser_ptr, tag_ids);
         }
 
-        void export_db(string export_fn) {
-            size_t ssize = serialize_size();
+        /** @brief Return the serialized size of a list of entries, in the
+         * format above */
+        static size_t serialize_size(const vector<DBEntry<>>& entries) {
+            size_t ser_size = 2*sizeof(size_t);
+            absl::flat_hash_set<tag_id_t> tag_ids;
+            for (auto & entry : entries) {
+                ser_size += sizeof(size_t) + entry.serialize_compact_size();
+                tag_ids.insert(entry.tag_ids().begin(), entry.tag_ids().end());
+            }
+            return ser_size + dictionary_size_(tag_ids);
+        }
 
-            pigo::WFile out_f {export_fn, ssize};
+        /** @brief Serialize a list of entries, in the format above */
+        static void serialize_entries(char*& ser_ptr, const vector<DBEntry<>>& entries) {
+            *(size_t*)ser_ptr = entries.size(); ser_ptr += sizeof(size_t);
+            size_t* entries_size = (size_t*)ser_ptr; ser_ptr += sizeof(size_t);
+            const char* entries_start = ser_ptr;
 
-            char* data_ptr = (char*)out_f.fp();
+            absl::flat_hash_set<tag_id_t> tag_ids;
+            for (auto & entry : entries) {
+                *(size_t*)ser_ptr = entry.serialize_compact_size(); ser_ptr += sizeof(size_t);
+                entry.serialize_compact(ser_ptr);
+                tag_ids.insert(entry.tag_ids().begin(), entry.tag_ids().end());
+            }
+            *entries_size = ser_ptr - entries_start;
+
+            serialize_dictionary_(ser_ptr, tag_ids);
+        }
+
+        /** @brief Return the size of a tag dictionary section */
+        static size_t dictionary_size_(const absl::flat_hash_set<tag_id_t>& tag_ids) {
+            // Format:
+            // <num(tags)>
+            // <foreach tag:
+            //      <tag id>
+            //      <size(tag)>
+            //      <tag>
+            // >
+            auto & dict = TagDictionary::get();
+            size_t ser_size = sizeof(size_t);
+            for (tag_id_t id : tag_ids)
+                ser_size += sizeof(tag_id_t) + sizeof(size_t) + dict.tag(id).size();
+            return ser_size;
+        }
+
+        /** @brief Write a tag dictionary section */
+        static void serialize_dictionary_(char*& ser_ptr, const absl::flat_hash_set<tag_id_t>& tag_ids) {
+            auto & dict = TagDictionary::get();
+            *(size_t*)ser_ptr = tag_ids.size(); ser_ptr += sizeof(size_t);
+            for (tag_id_t id : tag_ids) {
+                const string& tag = dict.tag(id);
+                *(tag_id_t*)ser_ptr = id; ser_ptr += sizeof(tag_id_t);
+                *(size_t*)ser_ptr = tag.size(); ser_ptr += sizeof(size_t);
+                memcpy(ser_ptr, tag.c_str(), tag.size()); ser_ptr += tag.size();
+            }
+        }
 
-            serialize_entries(data_ptr);
+        /** @brief Read a tag dictionary section, mapping its ids to ours */
+        static TagRemap deserialize_dictionary_(const char* ser) {
+            auto & dict = TagDictionary::get();
+            TagRemap remap;
+            size_t ntags = *(const size_t*)ser; ser += sizeof(size_t);
+            for (; ntags > 0; --ntags) {
+                tag_id_t id = *(const tag_id_t*)ser; ser += sizeof(tag_id_t);
+                size_t tag_size = *(const size_t*)ser; ser += sizeof(size_t);
+                remap[id] = dict.intern(string{ser, tag_size}); ser += tag_size;
+            }
+            return remap;
         }
 
-        void import_db(string import_fn) {
+        /** @brief Write every entry to a Snapshot file */
+        void export_db(string export_fn) {
+            auto & map = db_server_.get();
+            auto lock = map.read_lock();
+            Snapshot::write(export_fn, map.entries());
+        }
+
+        /** @brief Load the entries of an exported file
+         *
+         * @param owned if given, only entries whose keys it accepts are
+         *        loaded (snapshots only); the rest are skipped
+         */
+        void import_db(string import_fn, const function<bool(dbkey_t)>& owned = nullptr) {
+            if (Snapshot::is_snapshot(import_fn)) {
+                Snapshot snap {import_fn};
+                import_snapshot(snap, owned);
+                return;
+            }
+
+            // Files from before snapshots were versioned
             pigo::ROFile in_f {import_fn};
             const char* data_ptr = in_f.fp();
 
@@ -878,13 +1624,70 @@ class SeqDB {
 
         }
 
+        /** @brief Number of entries built and inserted together on import */
+        constexpr static size_t IMPORT_BATCH_SIZE = 1<<16;
+
+        /** @brief Load the entries of a snapshot
+         *
+         * Entries are built from the mapped file in parallel, a batch at a
+         * time.  When the snapshot's keys are unique, entries whose keys are
+         * not yet stored skip the merge checks of add_entry and are inserted
+         * in bulk.
+         */
+        void import_snapshot(const Snapshot& snap, const function<bool(dbkey_t)>& owned = nullptr) {
+            // Decide what to load from the keys alone
+            vector<size_t> selected;
+            selected.reserve(snap.size());
+            for (size_t i = 0; i < snap.size(); ++i) {
+                if (!owned || owned(snap.key(i)))
+                    selected.push_back(i);
+            }
+
+            size_t num_threads = max(1u, thread::hardware_concurrency());
+            vector<DBEntry<>> batch;
+            for (size_t start = 0; start < selected.size(); start += IMPORT_BATCH_SIZE) {
+                size_t batch_size = min(IMPORT_BATCH_SIZE, selected.size()-start);
+                batch.resize(batch_size);
+
+                // Build each thread's share of the batch
+                vector<thread> threads;
+                size_t per_thread = (batch_size+num_threads-1)/num_threads;
+                for (size_t t = 0; t*per_thread < batch_size; ++t) {
+                    threads.emplace_back([&, t]() {
+                        size_t end = min(batch_size, (t+1)*per_thread);
+                        for (size_t i = t*per_thread; i < end; ++i)
+                            batch[i] = snap.entry(selected[start+i]);
+                    });
+                }
+                for (auto & th : threads) th.join();
+
+                absl::flat_hash_map<dbkey_t, DBEntry<>> fresh;
+                fresh.reserve(batch_size);
+                for (auto & entry : batch) {
+                    dbkey_t key = entry.get_key();
+                    if (snap.unique_keys() && !db_->key_exist(key)) {
+                        handle_subscriptions(key);
+                        mark_dirty_(key);
+                        for (tag_id_t tag : entry.tag_ids())
+                            add_to_tag_index_(key, tag);
+                        fresh.emplace(key, move(entry));
+                    } else {
+                        add_entry_worker(move(entry));
+                    }
+                }
+                db_->insert_multiple(&fresh);
+            }
+        }
+
         void deserialize_and_add_entries(const char* ser) {
             size_t num_entries = *(const size_t*)ser; ser += sizeof(size_t);
+            size_t entries_size = *(const size_t*)ser; ser += sizeof(size_t);
+            TagRemap remap = deserialize_dictionary_(ser + entries_size);
 
             for (size_t i = 0; i < num_entries; i++) {
                 size_t entry_size = *(const size_t*)ser; ser += sizeof(size_t);
                 (void)entry_size;       // FIXME change protocol
-                DBEntry<> e(ser);
+                DBEntry<> e(ser, remap);
 
                 add_entry(move(e));
             }
@@ -895,11 +1698,13 @@ class SeqDB {
             vector<DBEntry<>> ret;
 
             size_t num_entries = *(const size_t*)ser; ser += sizeof(size_t);
+            size_t entries_size = *(const size_t*)ser; ser += sizeof(size_t);
+            TagRemap remap = deserialize_dictionary_(ser + entries_size);
 
             for (size_t i = 0; i < num_entries; i++) {
                 size_t entry_size = *(const size_t*)ser; ser += sizeof(size_t);
                 (void)entry_size;       // FIXME change protocol
-                DBEntry<> e(ser);
+                DBEntry<> e(ser, remap);
                 ret.push_back(move(e));
             }
 
@@ -934,6 +1739,7 @@ static void s_SeqDB_get_entry_by_tags(const fn* s_this, ...) {
     va_end(args);
 
     pando::SeqDB* db = (pando::SeqDB*)s_this->state;
+    auto lock = db->retrieval_lock();
     db->get_entry_value_by_tags(search_tags, res);
 }
 
@@ -946,10 +1752,24 @@ static void s_SeqDB_get_entry_by_key(const fn* s_this, ...) {
     va_end(args);
 
     pando::SeqDB* db = (pando::SeqDB*)s_this->state;
+    auto lock = db->retrieval_lock();
     db->get_entry_value_by_key(search_key, res);
 
 }
 
+static void s_SeqDB_get_entries_by_keys(const fn* s_this, ...) {
+    va_list args;
+    va_start(args, s_this);
+    size_t num_keys = va_arg(args, size_t);
+    const dbkey_t* search_keys = va_arg(args, const dbkey_t*);
+    char** res = va_arg(args, char**);
+    va_end(args);
+
+    pando::SeqDB* db = (pando::SeqDB*)s_this->state;
+    auto lock = db->retrieval_lock();
+    db->get_entry_values_by_keys(num_keys, search_keys, res);
+}
+
 static void s_SeqDB_get_entries_by_tags(const fn* s_this, ...) {
     va_list args;
     va_start(args, s_this);
@@ -958,6 +1778,7 @@ static void s_SeqDB_get_entries_by_tags(const fn* s_this, ...) {
     db_query_t callback = va_arg(args, db_query_t);
     va_end(args);
     pando::SeqDB* db = (pando::SeqDB*)s_this->state;
+    auto lock = db->retrieval_lock();
     db->get_entries_by_tags(search_tags, access, callback);
 }
 
@@ -1003,6 +1824,9 @@ static void s_SeqDB_subscribe_to_entry(const fn* s_this, ...) {
     DBAccess* acc = (DBAccess*)s_this->state;
     // Get the SeqDB from new_entry, the key from the key field
     pando::SeqDB* db = (pando::SeqDB*)acc->make_new_entry.state;
+    // Wake the running filter when the entry it runs on is released
+    if (my_key == acc->key && db->running_filter())
+        db->park(my_key, tag, db->running_filter());
     db->subscribe_to_entry_wrapper(my_key, wait_key, tag);
 }
 
@@ -1017,4 +1841,65 @@ static void s_SeqDB_update_entry_val(const fn* s_this, ...) {
     db->stage_update_entry_val(key, new_val);
 }
 
+static void s_SeqDB_staged_new_entry(const fn* s_this, ...) {
+    va_list args;
+    va_start(args, s_this);
+    const char* const* new_tags = va_arg(args, const char* const*);
+    const char* new_value = va_arg(args, const char*);
+    dbkey_t new_key = va_arg(args, dbkey_t);
+    va_end(args);
+
+    pando::StagedFilterOps* staged = (pando::StagedFilterOps*)s_this->state;
+    staged->ops.push_back({pando::StagedFilterOps::NEW_ENTRY, new_key, {}, "", {new_tags, new_value, new_key}, nullptr});
+}
+
+static void s_SeqDB_staged_add_tag(const fn* s_this, ...) {
+    va_list args;
+    va_start(args, s_this);
+    const char* new_tag = va_arg(args, const char*);
+    va_end(args);
+
+    DBAccess* acc = (DBAccess*)s_this->state;
+    pando::StagedFilterOps* staged = (pando::StagedFilterOps*)acc->make_new_entry.state;
+    staged->ops.push_back({pando::StagedFilterOps::ADD_TAG, acc->key, {}, new_tag, {}, nullptr});
+}
+
+static void s_SeqDB_staged_remove_tag(const fn* s_this, ...) {
+    va_list args;
+    va_start(args, s_this);
+    dbkey_t key = va_arg(args, dbkey_t);
+    const char* old_tag = va_arg(args, const char*);
+    va_end(args);
+
+    DBAccess* acc = (DBAccess*)s_this->state;
+    pando::StagedFilterOps* staged = (pando::StagedFilterOps*)acc->make_new_entry.state;
+    staged->ops.push_back({pando::StagedFilterOps::REMOVE_TAG, key, {}, old_tag, {}, nullptr});
+}
+
+static void s_SeqDB_staged_subscribe_to_entry(const fn* s_this, ...) {
+    va_list args;
+    va_start(args, s_this);
+    dbkey_t my_key = va_arg(args, dbkey_t);
+    dbkey_t wait_key = va_arg(args, dbkey_t);
+    const char* tag = va_arg(args, const char*);
+    va_end(args);
+
+    DBAccess* acc = (DBAccess*)s_this->state;
+    pando::StagedFilterOps* staged = (pando::StagedFilterOps*)acc->make_new_entry.state;
+    filter_p filter = my_key == acc->key ? staged->filter : nullptr;
+    staged->ops.push_back({pando::StagedFilterOps::SUBSCRIBE, my_key, wait_key, tag, {}, move(filter)});
+}
+
+static void s_SeqDB_staged_update_entry_val(const fn* s_this, ...) {
+    va_list args;
+    va_start(args, s_this);
+    dbkey_t key = va_arg(args, dbkey_t);
+    const char* new_val = va_arg(args, const char*);
+    va_end(args);
+
+    DBAccess* acc = (DBAccess*)s_this->state;
+    pando::StagedFilterOps* staged = (pando::StagedFilterOps*)acc->make_new_entry.state;
+    staged->ops.push_back({pando::StagedFilterOps::SET_VALUE, key, {}, new_val, {}, nullptr});
+}
+
 }
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "dbentry.hpp"
+#include "pigo.hpp"
+
+using namespace std;
+
+namespace pando {
+
+/** @brief Locates the sections of a snapshot file
+ *
+ * Stored at the very end of the file.  Offsets are from the start of the
+ * file.
+ */
+struct SnapshotFooter {
+    uint64_t num_entries;
+    /** @brief dbkey_t[num_entries] */
+    uint64_t keys;
+    /** @brief uint64_t[num_entries+1], each entry's start in the values */
+    uint64_t value_offsets;
+    /** @brief uint64_t[num_entries+1], each entry's start in the tag ids */
+    uint64_t tag_offsets;
+    /** @brief uint32_t per tag, indexing the dictionary */
+    uint64_t tag_ids;
+    /** @brief All values, back to back */
+    uint64_t values;
+    /** @brief <num tags> <foreach tag: <size> <tag>> */
+    uint64_t dictionary;
+    uint64_t flags;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t magic;
+};
+
+/** @brief A versioned, columnar snapshot of a database's entries
+ *
+ * The file is a header (magic and version), the key, value offset, tag
+ * offset, tag id, value, and dictionary sections (each 8-byte aligned), and
+ * a SnapshotFooter.  Tag ids in the file index its own dictionary rather
+ * than any process's TagDictionary.
+ *
+ * The file is memory-mapped, and each column can be read on its own; e.g.,
+ * deciding which entries to load only touches the keys.  Entries can be
+ * built from any number of threads at once.
+ */
+class Snapshot {
+    public:
+        constexpr static uint64_t MAGIC = 0x31504e5344444e50ull;  // "PNDDSNP1"
+        constexpr static uint32_t VERSION = 1;
+
+        /** @brief Set when no key appears twice in the snapshot */
+        constexpr static uint64_t UNIQUE_KEYS = 1;
+
+    private:
+        constexpr static size_t HEADER_SIZE = sizeof(uint64_t)+2*sizeof(uint32_t);
+
+        pigo::ROFile file_;
+        SnapshotFooter footer_;
+
+        const dbkey_t* keys_;
+        const uint64_t* value_offsets_;
+        const uint64_t* tag_offsets_;
+        const uint32_t* tag_ids_;
+        const char* values_;
+
+        /** @brief Map the snapshot's tag ids to TagDictionary ids */
+        vector<tag_id_t> tag_remap_;
+
+        static size_t align_(size_t pos) {
+            return (pos+7) & ~(size_t)7;
+        }
+
+    public:
+        /** @brief Open and map an existing snapshot */
+        Snapshot(string fn) : file_(fn) {
+            const char* data = file_.fp();
+            if (file_.size() < HEADER_SIZE+sizeof(SnapshotFooter))
+                throw runtime_error("Snapshot file is too small");
+            memcpy(&footer_, data+file_.size()-sizeof(SnapshotFooter), sizeof(SnapshotFooter));
+            if (footer_.magic != MAGIC)
+                throw runtime_error("Not a snapshot file");
+            if (footer_.version != VERSION)
+                throw runtime_error("Unsupported snapshot version");
+
+            keys_ = (const dbkey_t*)(data+footer_.keys);
+            value_offsets_ = (const uint64_t*)(data+footer_.value_offsets);
+            tag_offsets_ = (const uint64_t*)(data+footer_.tag_offsets);
+            tag_ids_ = (const uint32_t*)(data+footer_.tag_ids);
+            values_ = data+footer_.values;
+
+            // Intern the tags up front, so building entries does not lock
+            auto & dict = TagDictionary::get();
+            const char* ser = data+footer_.dictionary;
+            size_t ntags = *(const size_t*)ser; ser += sizeof(size_t);
+            tag_remap_.reserve(ntags);
+            for (; ntags > 0; --ntags) {
+                size_t tag_size = *(const size_t*)ser; ser += sizeof(size_t);
+                tag_remap_.push_back(dict.intern(string{ser, tag_size})); ser += tag_size;
+            }
+        }
+
+        /** @brief Return whether a file starts like a snapshot */
+        static bool is_snapshot(const string& fn) {
+            ifstream f {fn, ios::binary};
+            uint64_t magic = 0;
+            f.read((char*)&magic, sizeof(magic));
+            return f && magic == MAGIC;
+        }
+
+        /** @brief Return the number of entries */
+        size_t size() const { return footer_.num_entries; }
+
+        /** @brief Return whether every key in the snapshot is distinct */
+        bool unique_keys() const { return footer_.flags & UNIQUE_KEYS; }
+
+        /** @brief Return the key of the i-th entry */
+        const dbkey_t& key(size_t i) const { return keys_[i]; }
+
+        /** @brief Build the i-th entry */
+        DBEntry<> entry(size_t i) const {
+            DBEntry<> e;
+            e.set_key(keys_[i]);
+            e.value().assign(values_+value_offsets_[i], value_offsets_[i+1]-value_offsets_[i]);
+
+            vector<tag_id_t> ids;
+            ids.reserve(tag_offsets_[i+1]-tag_offsets_[i]);
+            for (uint64_t t = tag_offsets_[i]; t < tag_offsets_[i+1]; ++t)
+                ids.push_back(tag_remap_.at(tag_ids_[t]));
+            e.set_tag_ids(move(ids));
+
+            return e;
+        }
+
+        /** @brief Write the entries of a map from keys to DBEntry objects
+         *
+         * Keys in a map are distinct, so the snapshot is marked UNIQUE_KEYS.
+         */
+        template<typename Map>
+        static void write(const string& fn, const Map& entries) {
+            // Size each section, and number the tags in use
+            absl::flat_hash_map<tag_id_t, uint32_t> tag_index;
+            vector<tag_id_t> tags;
+            size_t num_entries = 0, num_tags = 0, values_size = 0;
+            for (auto & [key, entry] : entries) {
+                ++num_entries;
+                values_size += entry.value().size();
+                num_tags += entry.tag_ids().size();
+                for (tag_id_t id : entry.tag_ids()) {
+                    if (tag_index.try_emplace(id, tags.size()).second)
+                        tags.push_back(id);
+                }
+            }
+
+            auto & dict = TagDictionary::get();
+            size_t dictionary_size = sizeof(size_t);
+            for (tag_id_t id : tags)
+                dictionary_size += sizeof(size_t)+dict.tag(id).size();
+
+            SnapshotFooter footer;
+            memset(&footer, 0, sizeof(footer));
+            footer.num_entries = num_entries;
+            footer.keys = align_(HEADER_SIZE);
+            footer.value_offsets = align_(footer.keys + num_entries*sizeof(dbkey_t));
+            footer.tag_offsets = align_(footer.value_offsets + (num_entries+1)*sizeof(uint64_t));
+            footer.tag_ids = align_(footer.tag_offsets + (num_entries+1)*sizeof(uint64_t));
+            footer.values = align_(footer.tag_ids + num_tags*sizeof(uint32_t));
+            footer.dictionary = align_(footer.values + values_size);
+            footer.flags = UNIQUE_KEYS;
+            footer.version = VERSION;
+            footer.magic = MAGIC;
+            size_t file_size = align_(footer.dictionary + dictionary_size) + sizeof(SnapshotFooter);
+
+            pigo::WFile out_f {fn, file_size};
+            // The new file reads as zeros, which covers the padding
+            char* data = (char*)out_f.fp();
+
+            *(uint64_t*)data = MAGIC;
+            *(uint32_t*)(data+sizeof(uint64_t)) = VERSION;
+
+            dbkey_t* keys = (dbkey_t*)(data+footer.keys);
+            uint64_t* value_offsets = (uint64_t*)(data+footer.value_offsets);
+            uint64_t* tag_offsets = (uint64_t*)(data+footer.tag_offsets);
+            uint32_t* tag_ids = (uint32_t*)(data+footer.tag_ids);
+            char* values = data+footer.values;
+
+            uint64_t value_pos = 0, tag_pos = 0;
+            size_t i = 0;
+            for (auto & [key, entry] : entries) {
+                keys[i] = key;
+                value_offsets[i] = value_pos;
+                tag_offsets[i] = tag_pos;
+
+                auto & value = entry.value();
+                memcpy(values+value_pos, value.data(), value.size());
+                value_pos += value.size();
+                for (tag_id_t id : entry.tag_ids())
+                    tag_ids[tag_pos++] = tag_index[id];
+                ++i;
+            }
+            value_offsets[num_entries] = value_pos;
+            tag_offsets[num_entries] = tag_pos;
+
+            char* ser = data+footer.dictionary;
+            *(size_t*)ser = tags.size(); ser += sizeof(size_t);
+            for (tag_id_t id : tags) {
+                const string& tag = dict.tag(id);
+                *(size_t*)ser = tag.size(); ser += sizeof(size_t);
+                memcpy(ser, tag.c_str(), tag.size()); ser += tag.size();
+            }
+
+            memcpy(data+file_size-sizeof(SnapshotFooter), &footer, sizeof(SnapshotFooter));
+        }
+};
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+
+#include "absl/container/node_hash_map.h"
+
+using namespace std;
+
+namespace pando {
+
+/** @brief A small integer standing in for a tag string */
+using tag_id_t = uint32_t;
+
+/** @brief Interns tag strings, handing out a stable id for each
+ *
+ * The same few tags (e.g., "BTC", "tx", "BTC_tx_vals:done") repeat across a
+ * huge number of entries, so entries store tag ids and look the strings up
+ * here.  There is one dictionary per process, and ids are only meaningful
+ * within that process; anything leaving the process carries the strings.
+ *
+ * Tags are never removed, so the strings (and their C strings) stay valid
+ * for the life of the process.  Looking up the string for an id does not
+ * lock.
+ */
+class TagDictionary {
+    public:
+        /** @brief Returned by find when a tag has never been interned */
+        constexpr static tag_id_t NO_TAG = ~(tag_id_t)0;
+
+    private:
+        constexpr static size_t CHUNK_BITS = 12;
+        constexpr static size_t CHUNK_SIZE = 1 << CHUNK_BITS;
+        constexpr static size_t MAX_CHUNKS = 1 << 16;
+
+        /** @brief Protects ids_ and the creation of new ids */
+        mutable shared_mutex mutex_;
+
+        /** @brief Map each tag to its id; nodes keep the strings in place */
+        absl::node_hash_map<string, tag_id_t> ids_;
+
+        /** @brief Map each id back to its tag, in fixed-size chunks that
+         * never move once allocated */
+        atomic<const string**> chunks_[MAX_CHUNKS];
+
+        /** @brief The number of ids handed out */
+        atomic<tag_id_t> size_;
+
+        TagDictionary() : size_(0) {
+            for (auto & chunk : chunks_)
+                chunk.store(nullptr, memory_order_relaxed);
+        }
+
+    public:
+        ~TagDictionary() {
+            for (auto & chunk : chunks_)
+                delete [] chunk.load(memory_order_relaxed);
+        }
+
+        TagDictionary(const TagDictionary&) = delete;
+        TagDictionary& operator=(const TagDictionary&) = delete;
+
+        /** @brief Return the process-wide dictionary */
+        static TagDictionary& get() {
+            static TagDictionary dict;
+            return dict;
+        }
+
+        /** @brief Return the id for a tag, creating one if needed */
+        tag_id_t intern(const string& tag) {
+            {
+                shared_lock lock(mutex_);
+                auto it = ids_.find(tag);
+                if (it != ids_.end()) return it->second;
+            }
+
+            unique_lock lock(mutex_);
+            auto [it, inserted] = ids_.try_emplace(tag, size_.load(memory_order_relaxed));
+            if (!inserted) return it->second;
+
+            tag_id_t id = it->second;
+            size_t chunk = id >> CHUNK_BITS;
+            if (chunk >= MAX_CHUNKS) throw runtime_error("Too many distinct tags");
+
+            const string** tags = chunks_[chunk].load(memory_order_relaxed);
+            if (tags == nullptr) {
+                tags = new const string*[CHUNK_SIZE];
+                chunks_[chunk].store(tags, memory_order_release);
+            }
+            tags[id & (CHUNK_SIZE-1)] = &it->first;
+            size_.store(id+1, memory_order_release);
+
+            return id;
+        }
+
+        /** @brief Return the id for a tag, or NO_TAG if it was never interned */
+        tag_id_t find(const string& tag) const {
+            shared_lock lock(mutex_);
+            auto it = ids_.find(tag);
+            if (it == ids_.end()) return NO_TAG;
+            return it->second;
+        }
+
+        /** @brief Return the tag for an id */
+        const string& tag(tag_id_t id) const {
+            // Ids only come from intern, which published the chunk first
+            const string** tags = chunks_[id >> CHUNK_BITS].load(memory_order_acquire);
+            return *tags[id & (CHUNK_SIZE-1)];
+        }
+
+        /** @brief Return the tag for an id as a C string */
+        const char* c_str(tag_id_t id) const {
+            return tag(id).c_str();
+        }
+
+        /** @brief Return the number of distinct tags */
+        size_t size() const {
+            return size_.load(memory_order_acquire);
+        }
+};
+
+}
@@ -4,24 +4,40 @@ from glob import glob
 from pando_api import *
 from multiprocessing import Pool
 
-def _query_target(addr, tags):
-    c_t = ParDBClient(addr)
-    return c_t.query(tags)
-
-def query_all(client, tags):
+def query_iter(client, tags, page_size=4096, fields=QUERY_ALL, value_prefix=None):
+    """Yield the entries with all of the tags, from every agent
+
+    Results come a page at a time, with the next page from each agent
+    fetched while the current one is used. fields picks which of
+    QUERY_TAGS and QUERY_VALUE each entry keeps (0 for keys only), and
+    value_prefix keeps at most that many bytes of each value.
+    """
     if not isinstance(tags, list):
         tags = [tags]
+    if value_prefix is None:
+        value_prefix = 2**64 - 1
 
-    neighbors = client.neighbors()
-    with Pool(32) as pool:
-        entry_lists = pool.starmap(_query_target, zip(neighbors, tags*len(neighbors)))
+    query = ParDBQuery(client.neighbors(), tags, page_size, fields, value_prefix)
+    while True:
+        page = query.next_page()
+        if not page:
+            return
+        yield from page
 
-    entries = []
+def query_all(client, tags):
+    return list(query_iter(client, tags))
 
-    for entry_list in entry_lists:
-        entries.extend(entry_list)
+def aggregate(client, tags, group_by=""):
+    """Return the count, sum, min and max of the values of the entries with
+    all of the tags, as a dict from group to Aggregate
 
-    return entries
+    Each agent aggregates its own entries, so only the partial results are
+    sent. group_by is "" for one group, "key.a", "key.b" or "key.c" to group
+    by that key field, or a tag prefix such as "month=".
+    """
+    if not isinstance(tags, list):
+        tags = [tags]
+    return aggregate_all(client.neighbors(), tags, group_by)
 
 def _is_processing_target(addr):
     c_t = ParDBClient(addr)
@@ -6,6 +6,7 @@
 #include <pybind11/operators.h>
 #include "seq_db.hpp"
 #include "par_db_client.hpp"
+#include "par_db_query.hpp"
 #include "util.hpp"
 
 namespace py = pybind11;
@@ -109,12 +110,51 @@ PYBIND11_MODULE(PYBIND_MODULE_NAME, m) {
         .def("neighbors", &ParDBClient::neighbors)
         .def("processing", &ParDBClient::processing)
         .def("clear_filters", &ParDBClient::clear_filters)
+        .def("full_scan", &ParDBClient::full_scan)
+        .def("set_merge_strategy", &ParDBClient::set_merge_strategy)
         .def("installed_filters", &ParDBClient::installed_filters)
         .def("export_db", static_cast<void (ParDBClient::*)(string)>(&ParDBClient::export_db))
         .def("import_db", static_cast<void (ParDBClient::*)(string)>(&ParDBClient::import_db))
         .def("add_entry", &ParDBClient::add_entry)
         .def("get_state", &ParDBClient::get_state)
+        .def("aggregate", &ParDBClient::aggregate, py::arg("tags"), py::arg("group_by")="")
         //void add_neighbor(ZMQAddress addr) {
         //void add_entry(DBEntry<>& e) {
         ;
+
+    py::class_<pando::Aggregate>(m, "Aggregate")
+        .def_readonly("count", &Aggregate::count)
+        .def_readonly("values", &Aggregate::values)
+        .def_readonly("sum", &Aggregate::sum)
+        .def_readonly("min", &Aggregate::min)
+        .def_readonly("max", &Aggregate::max)
+        .def("mean", &Aggregate::mean)
+        ;
+
+    m.def("aggregate_all", [](vector<string> addrs, vector<string> tags, string group_by) {
+        elga::ZMQChatterbox::Setup();
+        py::gil_scoped_release release;
+        return aggregate_all(addrs, tags, group_by);
+    }, py::arg("addrs"), py::arg("tags"), py::arg("group_by")="");
+
+    m.attr("QUERY_TAGS") = pando::QUERY_TAGS;
+    m.attr("QUERY_VALUE") = pando::QUERY_VALUE;
+    m.attr("QUERY_ALL") = pando::QUERY_ALL;
+
+    py::class_<pando::ParDBQuery>(m, "ParDBQuery")
+        .def(py::init([](vector<string> addrs, vector<string> tags, size_t page_size, uint8_t fields, size_t value_prefix) {
+            elga::ZMQChatterbox::Setup();
+            return std::unique_ptr<ParDBQuery>(new ParDBQuery(addrs, tags, page_size, fields, value_prefix));
+        }), py::arg("addrs"), py::arg("tags"), py::arg("page_size"),
+            py::arg("fields")=pando::QUERY_ALL, py::arg("value_prefix")=SIZE_MAX)
+        .def("next_page", [](ParDBQuery &self) {
+            // Let other Python threads run while waiting on the agents
+            vector<DBEntry<>> page;
+            {
+                py::gil_scoped_release release;
+                self.next_page(page);
+            }
+            return page;
+        })
+        ;
 }
@@ -256,6 +256,47 @@ cdef inline object get_entry_by_key(const DBAccess* access, dbkey_t search_key):
         return py_ret
         
 
+cdef inline list get_entries_by_keys(const DBAccess* access, list search_keys):
+    """
+      Function:
+          get_entries_by_keys
+
+      Description:
+          Finds and returns the values associated with each of the search_keys, in one call
+
+      Parameters:
+          access (const DBAccess*)  : A pointer to the DBAccess object  
+          search_keys (list)        : The keys (dbkey_t) to the entries intended to be returned
+          
+      Calls:
+          access.get_entries_by_keys.run()
+
+      Modifies:
+          access
+
+      Returns:
+          list[bytes | None], in the order of search_keys
+    """
+    cdef size_t num_keys = len(search_keys)
+    cdef dbkey_t* keys = <dbkey_t*>malloc(num_keys*sizeof(dbkey_t))
+    cdef char** ret = <char**>malloc(num_keys*sizeof(char*))
+    cdef size_t i
+    for i in range(num_keys):
+        keys[i] = search_keys[i]
+    access.get_entries_by_keys.run(&access.get_entries_by_keys, num_keys, keys, ret)
+
+    py_ret = []
+    for i in range(num_keys):
+        if not ret[i]:
+            py_ret.append(None)
+        else:
+            py_ret.append(PyBytes_FromString(ret[i]))
+            free(ret[i])
+    free(keys)
+    free(ret)
+    return py_ret
+
+
 cdef inline bytes make_tag(tag_name):
     """
       Function:
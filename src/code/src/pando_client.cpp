@@ -32,8 +32,10 @@ int main_(int argc, char **argv) {
             "  add_db_file    file        : load entries from a text file\n"
             "  process                    : process a single round of filters\n"
             "  clear_filters              : Uninstall all filters on all DBs\n"
+            "  full_scan                  : check every entry in the next round\n"
             "  export_db      export-dir  : export a pando db to a directory\n"
             "  import_db      import-dir  : import pando db files from  a directory\n"
+            "  import_db_routed import-dir: import from a directory, sending entries to their owners\n"
             "  print_entries              : (DEBUGGING) tell a pardb to print its entries\n"
             "  stage_close                : (DEBUGGING) -- force a stage close\n"
             "  check_at_barrier           : (DEBUGGING) -- call the check_at_barrier function\n"
@@ -76,6 +78,9 @@ int main_(int argc, char **argv) {
     }
     else if (cmd == "clear_filters") {
         c.clear_filters();
+    }
+    else if (cmd == "full_scan") {
+        c.full_scan();
     } else if (cmd == "export_db") {
         if (argc < 4) throw runtime_error("Missing argument");
         string export_dir {argv[3]};
@@ -86,6 +91,11 @@ int main_(int argc, char **argv) {
         string import_dir {argv[3]};
         c.import_db(import_dir);
     }
+    else if (cmd == "import_db_routed") {
+        if (argc < 4) throw runtime_error("Missing argument");
+        string import_dir {argv[3]};
+        c.import_db(import_dir, true);
+    }
     else if (cmd == "stage_close") {
         c.stage_close();
     }
@@ -29,7 +29,7 @@ void set_handler() {
 int main_(int argc, char **argv) {
     cerr << "[Pando] [INFO] Loading..." << endl;
 
-    if (argc < 2 || argc > 5) {
+    if (argc < 2 || argc > 9) {
         cerr << "Usage: pando_pardb bind-addr [seed-addr] [-M<mem in GB>]\n"
             "\n"
             "Parameters:\n"
@@ -37,6 +37,12 @@ int main_(int argc, char **argv) {
             "  seed-addr : an address in a mesh to join\n"
             "  -M<mem> : memory in GB, defaults to 16 (e.g., -M8 would allocate 8 GB)\n"
             "  --skip-group-filters : skip processing of group filters\n"
+            "  --ipc-map : access the local entry map over ZMQ rather than in-process\n"
+            "  --compact-map : after a stage, rewrite the entry map into fresh memory once\n"
+            "                  more than half of its memory is freed or fragmented\n"
+            "  --filter-threads=<n> : run thread-safe filters on n threads, defaults to 1\n"
+            "  --incremental : after the first stage, only check the entries created or\n"
+            "                  changed in the previous stage\n"
             "\n"
             "Addresses are of the form: IPv4-string,ID\n"
             "  IPv4-string : a period separated IP address, e.g., 1.2.3.4\n"
@@ -49,11 +55,23 @@ int main_(int argc, char **argv) {
     string seed_addr;
     size_t sz = 16ull*(1ull<<30);
     bool skip_group_filters = false;
+    bool ipc_map = false;
+    double compact_threshold = 0;
+    size_t filter_threads = 1;
+    bool incremental = false;
     for (int idx = 2; idx < argc; ++idx) {
         if (argv[idx][0] == '-' && argv[idx][1] == 'M') {
             sz = (1ull<<30)*strtoul(&(argv[idx][2]), NULL, 10);
         } else if (std::string(argv[idx]) == "--skip-group-filters") {
             skip_group_filters = true;
+        } else if (std::string(argv[idx]) == "--ipc-map") {
+            ipc_map = true;
+        } else if (std::string(argv[idx]) == "--compact-map") {
+            compact_threshold = 0.5;
+        } else if (std::string(argv[idx]).rfind("--filter-threads=", 0) == 0) {
+            filter_threads = strtoul(argv[idx]+strlen("--filter-threads="), NULL, 10);
+        } else if (std::string(argv[idx]) == "--incremental") {
+            incremental = true;
         } else {
             if (seed_addr.size() != 0) throw runtime_error("Multiple seed addrs given");
             seed_addr.assign(argv[idx]);
@@ -61,7 +79,7 @@ int main_(int argc, char **argv) {
     }
 
     cerr << "[Pando] [DEBUG] Bind addr=" << bind_addr.get_conn_str(bind_addr, REQUEST) << " memory=" << sz << endl;
-    ParDBThread db { bind_addr, sz, skip_group_filters };
+    ParDBThread db { bind_addr, sz, skip_group_filters, ipc_map, compact_threshold, filter_threads, incremental };
 
     if (argc > 2) {
         elga::ZMQAddress seed_addr = get_zmq_addr(argv[2]);
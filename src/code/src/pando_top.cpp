@@ -15,7 +15,7 @@ using namespace pando;
 
 class PandoTop : public PandoParticipant {
     private:
-        unordered_map<addr_t, tuple<time_t, size_t>> db_state_;
+        unordered_map<addr_t, tuple<time_t, size_t, size_t, size_t>> db_state_;
     public:
         PandoTop() : PandoParticipant(elga::ZMQAddress{}, false) {
             sub(STATS);
@@ -23,16 +23,18 @@ class PandoTop : public PandoParticipant {
         void process_msg([[maybe_unused]] msg_type_t type, [[maybe_unused]] zmq_socket_t sock, [[maybe_unused]] const char *data, [[maybe_unused]] const char *end) {
             if (type == STATS) {
                 addr_t agent;
-                size_t size;
+                size_t size, cache_hits, cache_misses;
                 unpack_single(data, agent);
                 unpack_single(data, size);
+                unpack_single(data, cache_hits);
+                unpack_single(data, cache_misses);
                 time_t now = time(nullptr);
-                db_state_[agent] = {now, size};
+                db_state_[agent] = {now, size, cache_hits, cache_misses};
             } else
                 recv_unknown_msg();
         }
-        tuple<time_t, size_t> get_state(addr_t addr) {
-            if (db_state_.count(addr) == 0) return {0, 0};
+        tuple<time_t, size_t, size_t, size_t> get_state(addr_t addr) {
+            if (db_state_.count(addr) == 0) return {0, 0, 0, 0};
             return db_state_[addr];
         }
 };
@@ -63,9 +65,11 @@ struct WinPos {
 struct AgentData {
     WINDOW* w;
     size_t db_size;
+    size_t cache_hits;
+    size_t cache_misses;
     time_t last_seen;
     string str;
-    AgentData() : w(nullptr), db_size(0), last_seen(0) { }
+    AgentData() : w(nullptr), db_size(0), cache_hits(0), cache_misses(0), last_seen(0) { }
 };
 
 class PandoData {
@@ -82,7 +86,7 @@ class PandoData {
             return {w, y, x};
         }
 
-        const int blk_h_ = 3;
+        const int blk_h_ = 4;
         const int blk_w_ = 22;
         const int blk_pad_ = 1;
 
@@ -182,10 +186,12 @@ class PandoData {
                 }
 
                 // Update the state
-                auto [ls, size] = pp_.get_state(addr);
+                auto [ls, size, cache_hits, cache_misses] = pp_.get_state(addr);
                 if (ls != 0 || true) {
                     auto w = agents_[addr].w;
                     agents_[addr].db_size = size;
+                    agents_[addr].cache_hits = cache_hits;
+                    agents_[addr].cache_misses = cache_misses;
                     agents_[addr].last_seen = ls;
                     auto age = time(nullptr) - agents_[addr].last_seen;
                     if (age > 999) age = 999;
@@ -215,6 +221,9 @@ class PandoData {
                     string addr_str = agents_[addr].str;
                     mvwprintw(w, 0, 1, "%s", addr_str.c_str());
                     mvwprintw(w, 1, 2, "DB size : %-8ld", agents_[addr].db_size);
+                    size_t lookups = agents_[addr].cache_hits + agents_[addr].cache_misses;
+                    double hit_pct = lookups == 0 ? 0 : 100.0*agents_[addr].cache_hits/lookups;
+                    mvwprintw(w, 2, 2, "Cache hit: %5.1f%%", hit_pct);
                     wrefresh(w);
                 }
             }
@@ -127,7 +127,9 @@ extern "C" {
         should_run: &should_run,
         init: &init,
         destroy: &destroy,
-        run: &run
+        run: &run,
+        predicate: nullptr,
+        thread_safe: false
     };
 }
 
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <string>
+
+#include "filter.hpp"
+#include "dbkey.h"
+
+using namespace std;
+using namespace pando;
+
+static const char* filter_name = "test_pardb_filters_get_entries";
+static const char* filter_done_tag = "test_pardb_filters_get_entries:done";
+static const char* filter_fail_tag = "test_pardb_filters_get_entries:fail";
+
+void run_(const DBAccess *access) {
+    const size_t num_keys = 3;
+    dbkey_t search_keys[num_keys] { {2,2,4}, {2,4,4}, {2,6,6} };
+    char* ret[num_keys];
+    access->get_entries_by_keys.run(&access->get_entries_by_keys, num_keys, search_keys, ret);
+
+    // The last key does not exist
+    if (ret[2] != nullptr) {
+        free(ret[2]);
+        throw runtime_error("Expected a missing entry");
+    }
+    if (ret[0] == nullptr || ret[1] == nullptr) {
+        free(ret[0]);
+        free(ret[1]);
+        access->add_tag.run(&access->add_tag, "NOT_FOUND");
+        access->add_tag.run(&access->add_tag, filter_fail_tag);
+        return;
+    }
+
+    string ret0 {ret[0]}, ret1 {ret[1]};
+    free(ret[0]);
+    free(ret[1]);
+
+    if (ret0 != "test1" || ret1 != "test2") {
+        cerr << "Expected: test1,test2 instead got:" << ret0 << "," << ret1 << endl;
+        throw runtime_error("Expected value not found");
+    }
+    access->add_tag.run(&access->add_tag, filter_done_tag);
+}
+
+// Fit the Pando API
+extern "C" {
+    /** @brief Main filter entry point */
+    extern void run(void* access) {
+        // Run internally
+        run_((DBAccess*)access);
+    }
+
+    extern bool should_run(const DBAccess* access) {
+        auto tags = access->tags;
+        bool will_run = false;
+        while ((*tags)[0] != '\0') {
+            if (string(*tags) == filter_fail_tag)
+                return false;
+            if (string(*tags) == filter_done_tag)
+                return false;
+            if (string(*tags) == "A")
+                will_run = true;
+            ++tags;
+        }
+        return will_run;
+    }
+
+    /** @brief Contains the entry point and tags for the filter */
+    extern const FilterInterface filter {
+        filter_name: filter_name,
+        filter_type: SINGLE_ENTRY,
+        should_run: &should_run,
+        init: nullptr,
+        destroy: nullptr,
+        run: &run,
+        predicate: nullptr,
+        thread_safe: false
+    };
+}
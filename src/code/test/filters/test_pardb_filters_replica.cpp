@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+
+#include "filter.hpp"
+#include "dbkey.h"
+
+using namespace std;
+using namespace pando;
+
+static const char* filter_name = "test_pardb_filters_replica";
+static const char* filter_done_tag = "seen:v3";
+
+/** Every entry tagged A reads the value of {2,4,4} each stage, and the entry
+ * tagged W moves that value from v1 to v2 to v3 */
+void run_(const DBAccess *access) {
+    char* ret = nullptr;
+    dbkey_t search_key {2,4,4};
+    access->get_entry_by_key.run(&access->get_entry_by_key, search_key, &ret);
+    if (ret == nullptr)
+        throw runtime_error("Expected entry not found");
+
+    string value {ret};
+    free(ret);
+
+    string seen_tag = "seen:" + value;
+    access->add_tag.run(&access->add_tag, seen_tag.c_str());
+
+    bool writer = false;
+    for (auto tags = access->tags; (*tags)[0] != '\0'; ++tags) {
+        if (string(*tags) == "W")
+            writer = true;
+    }
+    if (!writer) return;
+
+    if (value == "v1")
+        access->update_entry_val.run(&access->update_entry_val, search_key, "v2");
+    else if (value == "v2")
+        access->update_entry_val.run(&access->update_entry_val, search_key, "v3");
+}
+
+// Fit the Pando API
+extern "C" {
+    /** @brief Main filter entry point */
+    extern void run(void* access) {
+        // Run internally
+        run_((DBAccess*)access);
+    }
+
+    extern bool should_run(const DBAccess* access) {
+        auto tags = access->tags;
+        bool will_run = false;
+        while ((*tags)[0] != '\0') {
+            if (string(*tags) == filter_done_tag)
+                return false;
+            if (string(*tags) == "A")
+                will_run = true;
+            ++tags;
+        }
+        return will_run;
+    }
+
+    /** @brief Contains the entry point and tags for the filter */
+    extern const FilterInterface filter {
+        filter_name: filter_name,
+        filter_type: SINGLE_ENTRY,
+        should_run: &should_run,
+        init: nullptr,
+        destroy: nullptr,
+        run: &run,
+        predicate: nullptr,
+        thread_safe: false
+    };
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <string>
+
+#include "filter.hpp"
+#include "dbkey.h"
+
+using namespace std;
+using namespace pando;
+
+static const char* filter_name = "test_pardb_filters_sum";
+static const char* filter_done_tag = "test_pardb_filters_sum:done";
+
+void run_(const DBAccess *access) {
+    // Count each entry three times, in each of a few keys
+    const char* new_tags[] = {"count", "MERGE_STRATEGY=SUM", ""};
+    for (vtx_t i = 0; i < 4; ++i) {
+        dbkey_t new_key {2,i,2};
+        for (int n = 0; n < 3; ++n)
+            access->make_new_entry.run(&access->make_new_entry, new_tags, "1", new_key);
+    }
+    access->add_tag.run(&access->add_tag, filter_done_tag);
+}
+
+// Fit the Pando API
+extern "C" {
+    /** @brief Main filter entry point */
+    extern void run(void* access) {
+        // Run internally
+        run_((DBAccess*)access);
+    }
+
+    extern bool should_run(const DBAccess* access) {
+        auto tags = access->tags;
+        bool a_found = false;
+        while ((*tags)[0] != '\0') {
+            if (string(*tags) == "A")
+                a_found = true;
+            if (string(*tags) == filter_done_tag)
+                return false;
+            ++tags;
+        }
+        return a_found;
+    }
+
+    /** @brief Contains the entry point and tags for the filter */
+    extern const FilterInterface filter {
+        filter_name: filter_name,
+        filter_type: SINGLE_ENTRY,
+        should_run: &should_run,
+        init: nullptr,
+        destroy: nullptr,
+        run: &run,
+        predicate: nullptr,
+        thread_safe: false
+    };
+}
+
@@ -119,7 +119,9 @@ TEST(filter_types) {
         should_run: &g_TEST_filter_types_sroe,
         init: &g_forward_init,
         destroy: &g_forward_destroy,
-        run: &g_TEST_filter_types_run
+        run: &g_TEST_filter_types_run,
+        predicate: nullptr,
+        thread_safe: false
     };
     g_TEST_filter_types_pass = 0;
     db.install_filter(make_shared<Filter>(&i));
@@ -172,7 +174,9 @@ TEST(should_run) {
         should_run: &g_TEST_should_run_sroe,
         init: &g_forward_init,
         destroy: &g_forward_destroy,
-        run: &g_TEST_should_run_run
+        run: &g_TEST_should_run_run,
+        predicate: nullptr,
+        thread_safe: false
     };
     g_TEST_should_run_pass = 0;
     db.install_filter(make_shared<Filter>(&i));
@@ -221,7 +225,9 @@ TEST(should_run_tags) {
         should_run: &g_TEST_should_run_tags_sroe,
         init: &g_forward_init,
         destroy: &g_forward_destroy,
-        run: &g_TEST_should_run_tags_run
+        run: &g_TEST_should_run_tags_run,
+        predicate: nullptr,
+        thread_safe: false
     };
     g_TEST_should_run_tags_pass = 0;
     db.install_filter(make_shared<Filter>(&interface));
@@ -249,7 +255,9 @@ TEST(create_entry) {
         should_run: &g_TEST_create_entry_sroe,
         init: &g_forward_init,
         destroy: &g_forward_destroy,
-        run: &g_TEST_create_entry_run
+        run: &g_TEST_create_entry_run,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     {
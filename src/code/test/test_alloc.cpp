@@ -172,6 +172,93 @@ TEST(str_move) {
     TEST_PASS
 }
 
+TEST(reuse_freed) {
+    BigSpace sp { 1ull<<10 };
+
+    char* a1 = (char*)sp.allocate(40);
+    char* a2 = (char*)sp.allocate(40);
+    (void)a2;
+    sp.deallocate(a1, 40);
+    EQ(sp.free_bytes(), 40);
+
+    // A block of the same size comes off the free list
+    char* a3 = (char*)sp.allocate(40);
+    NOPRINT_EQ(a3, a1);
+    EQ(sp.free_bytes(), 0);
+    EQ(sp.used(), 80);
+
+    TEST_PASS
+}
+
+TEST(split_freed) {
+    BigSpace sp { 1ull<<10 };
+
+    char* a1 = (char*)sp.allocate(100);
+    char* a2 = (char*)sp.allocate(8);
+    (void)a2;
+    sp.deallocate(a1, 100);
+
+    // A larger class is split, and the rest is kept for later
+    char* a3 = (char*)sp.allocate(60);
+    NOPRINT_EQ(a3, a1);
+    EQ(sp.free_bytes(), 40);
+    char* a4 = (char*)sp.allocate(33);
+    NOPRINT_EQ(a4, a1+60);
+
+    // The 7 bytes left over are too small to reuse
+    EQ(sp.free_bytes(), 0);
+    EQ(sp.wasted(), 7);
+    EQ(sp.used(), 108);
+    EQ(sp.live(), 101);
+    EQ(sp.fragmented(), 7);
+
+    TEST_PASS
+}
+
+TEST(free_last) {
+    BigSpace sp { 64 };
+
+    char* a1 = (char*)sp.allocate(8);
+    char* a2 = (char*)sp.allocate(40);
+    sp.deallocate(a2, 40);
+    EQ(sp.used(), 8);
+
+    // The whole space is available again
+    char* a3 = (char*)sp.allocate(56);
+    NOPRINT_EQ(a3, a1+8);
+
+    sp.deallocate(a1, 8);
+    EQ(sp.wasted(), 8);
+    EQ(sp.live(), 56);
+
+    TEST_PASS
+}
+
+TEST(str_reuse) {
+    using Str = basic_string<char, char_traits<char>, BigSpaceAllocator<char>>;
+
+    auto sp = std::make_shared<BigSpace>(1ull<<12);
+    BigSpaceAllocator<char> alloc{sp};
+
+    // Repeatedly replacing a value does not grow the space
+    Str str {alloc};
+    str.assign("0000000000000000asdf");
+    Str other {alloc};
+    other.assign("1111111111111111asdf");
+    size_t used = sp->used();
+    for (int i = 0; i < 100; ++i) {
+        Str next {alloc};
+        next.assign(str);
+        next += "a";
+        str = move(next);
+        str.resize(20);
+        str.shrink_to_fit();
+    }
+    EQ(sp->used() <= used+64, true);
+
+    TEST_PASS
+}
+
 TESTS_BEGIN
     RUN_TEST(bigspace)
     RUN_TEST(oom)
@@ -183,4 +270,8 @@ TESTS_BEGIN
     RUN_TEST(str_plus_equals)
     RUN_TEST(str_plus_equals_two)
     RUN_TEST(str_move)
+    RUN_TEST(reuse_freed)
+    RUN_TEST(split_freed)
+    RUN_TEST(free_last)
+    RUN_TEST(str_reuse)
 TESTS_END
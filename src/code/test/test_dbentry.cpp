@@ -5,6 +5,7 @@
 #include <string>
 
 #include "dbentry.hpp"
+#include "big_space.hpp"
 
 using namespace std;
 using namespace pando;
@@ -431,6 +432,40 @@ TEST(move_assignment) {
     TEST_PASS
 }
 
+TEST(move_keeps_value) {
+    // Moving hands over the value's buffer, with either allocator
+    const string long_value = "a value longer than the small string buffer";
+
+    DBEntry<> db1;
+    db1.value() = long_value;
+    const char* data = db1.value().data();
+
+    DBEntry<> db2 {move(db1)};
+    EQ((const void*)db2.value().data(), (const void*)data);
+
+    DBEntry<> db3;
+    db3 = move(db2);
+    EQ((const void*)db3.value().data(), (const void*)data);
+    EQ(db3.value(), long_value);
+
+    using Alloc = BigSpaceAllocator<char>;
+    Alloc alloc {make_shared<BigSpace>(1ull<<10)};
+    DBEntry<Alloc> be1 {alloc};
+    be1.value() = long_value;
+    data = be1.value().data();
+
+    DBEntry<Alloc> be2 {move(be1)};
+    EQ((const void*)be2.value().data(), (const void*)data);
+
+    // The target's space differs, so it takes over the source's space too
+    DBEntry<Alloc> be3 {Alloc{make_shared<BigSpace>(1ull<<10)}};
+    be3 = move(be2);
+    EQ((const void*)be3.value().data(), (const void*)data);
+    EQ(be3.value(), long_value.c_str());
+
+    TEST_PASS
+}
+
 TEST(access) {
     DBEntry<> db;
 
@@ -628,6 +663,61 @@ TEST(serialize) {
     TEST_PASS
 }
 
+TEST(interned_tags) {
+    DBEntry<> e1; e1.add_tag("test1", "test2");
+    DBEntry<> e2; e2.add_tag("test2", "test3");
+
+    // The same tag shares the same id and C string
+    auto & dict = TagDictionary::get();
+    tag_id_t id = dict.find("test2");
+    NOTEQ(id, TagDictionary::NO_TAG);
+    EQ(e1.has_tag_id(id), true);
+    EQ(e2.has_tag_id(id), true);
+    EQ(string{dict.c_str(id)}, "test2");
+
+    // Checking an unknown tag does not add it to the dictionary
+    size_t dict_size = dict.size();
+    EQ(e1.has_tag("never_added"), false);
+    EQ(dict.size(), dict_size);
+
+    e1.merge_tags(e2);
+    EQ(e1.tag_size(), 3);
+    EQ(e1.has_tag("test3"), true);
+    EQ(e2.tag_size(), 2);
+
+    TEST_PASS
+}
+
+TEST(serialize_compact) {
+    dbkey_t e1_key = {10,10,10};
+    DBEntry<> e1; e1.value() = "foo\nbar"; e1.add_tag("test1", "test2"); e1.set_key(e1_key);
+
+    char* e1s = new char[e1.serialize_compact_size()];
+    char* e1s_ptr = e1s;
+    e1.serialize_compact(e1s_ptr);
+    EQ((unsigned long)(e1s_ptr-e1s), e1.serialize_compact_size());
+
+    // Ids are translated through the dictionary sent alongside
+    auto & dict = TagDictionary::get();
+    TagRemap remap;
+    remap[dict.find("test1")] = dict.intern("other1");
+    remap[dict.find("test2")] = dict.intern("other2");
+
+    const char* e1s_des = e1s;
+    DBEntry<> e2 {e1s_des, remap};
+    EQ((unsigned long)e1s_ptr, (unsigned long)e1s_des);
+
+    EQ(e2.get_key(), e1_key);
+    EQ(e2.value(), "foo\nbar");
+    EQ(e2.tag_size(), 2);
+    EQ(e2.has_tag("other1"), true);
+    EQ(e2.has_tag("other2"), true);
+
+    delete [] e1s;
+
+    TEST_PASS
+}
+
 TESTS_BEGIN
     RUN_TEST(add_tags)
     RUN_TEST(remove_tag)
@@ -642,6 +732,7 @@ TESTS_BEGIN
     RUN_TEST(copy_assignment)
     RUN_TEST(move_constructor)
     RUN_TEST(move_assignment)
+    RUN_TEST(move_keeps_value)
     RUN_TEST(access)
     RUN_TEST(access_tagval)
     RUN_TEST(build_from_c)
@@ -653,4 +744,6 @@ TESTS_BEGIN
     RUN_TEST(build_with_key)
     RUN_TEST(not_equal)
     RUN_TEST(serialize)
+    RUN_TEST(interned_tags)
+    RUN_TEST(serialize_compact)
 TESTS_END
@@ -49,7 +49,9 @@ TEST(move_filter) {
         should_run: nullptr,
         init: nullptr,
         destroy: nullptr,
-        run: nullptr
+        run: nullptr,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     // Build a Filter
@@ -93,7 +95,9 @@ TEST(should_run) {
         should_run: &TEST_should_run_filter,
         init: nullptr,
         destroy: nullptr,
-        run: nullptr
+        run: nullptr,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     // Build a Filter
@@ -121,7 +125,9 @@ TEST(run_filter) {
         should_run: nullptr,
         init: nullptr,
         destroy: nullptr,
-        run: &TEST_run_filter_filter
+        run: &TEST_run_filter_filter,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     // Build a Filter
@@ -141,7 +147,9 @@ TEST(check_type) {
         should_run: nullptr,
         init: nullptr,
         destroy: nullptr,
-        run: nullptr
+        run: nullptr,
+        predicate: nullptr,
+        thread_safe: false
     };
     EQ(i.filter_type, SINGLE_ENTRY);
     i.filter_type = GROUP_ENTRIES;
@@ -156,7 +164,9 @@ TEST(init_fail) {
         should_run: nullptr,
         init: nullptr,
         destroy: nullptr,
-        run: nullptr
+        run: nullptr,
+        predicate: nullptr,
+        thread_safe: false
     };
     Filter a {&i};
     try {
@@ -143,6 +143,41 @@ TEST(tx_created) {
     db.process();
     EQ(db.size(), 7);
 
+    size_t block_count = 0;
+    size_t tx_count = 0;
+    size_t block_sz = 0;
+    size_t tx_sz = 0;
+    for (auto & [key, entry] : db.entries()) {
+        if (entry.has_tag("block")) {
+            ++block_count;
+            block_sz += entry.value().size();
+            continue;
+        }
+        EQ(entry.has_tag("tx"), true);
+        ++tx_count;
+        tx_sz += entry.value().size();
+        // Written as compact records, not JSON
+        EQ(entry.value().compare(0, 4, "TX1\t"), 0);
+    }
+    EQ(tx_sz*4 < block_sz, true);
+
+    EQ(block_count, 2);
+    EQ(tx_count, 5);
+
+    TEST_PASS
+}
+
+TEST(tx_created_json) {
+    // Blocks tagged tx_json still get their txs as pretty-printed JSON
+    SeqDB db { data_dir+"/simple_bitcoin.txt" };
+    db.add_filter_dir(build_dir + "/filters");
+    db.install_filter("BTC_block_to_tx");
+    for (auto & [key, entry] : db.entries())
+        db.add_tag_to_entry(key, "tx_json");
+    EQ(db.size(), 2);
+    db.process();
+    EQ(db.size(), 7);
+
     size_t block_count = 0;
     size_t tx_count = 0;
     size_t block_sz = 0;
@@ -168,7 +203,6 @@ TEST(tx_created) {
     TEST_PASS
 }
 
-
 TEST(python_performance) {
     // This doesn't actually test anything, but can be a good metric for comparison to c++ filters
     SeqDB db;
@@ -225,6 +259,7 @@ TESTS_BEGIN
     RUN_TEST(exclude_run)
     RUN_TEST(bad_json)
     RUN_TEST(tx_created)
+    RUN_TEST(tx_created_json)
     RUN_TEST(cpp_performance)
     RUN_TEST(python_performance)
     elga::ZMQChatterbox::Teardown();
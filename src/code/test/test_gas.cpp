@@ -58,7 +58,9 @@ TEST(standalone_gas) {
         should_run: &filter_yes_run,
         init: &standalone_gas_init,
         destroy: &standalone_gas_destroy,
-        run: &standalone_gas_run
+        run: &standalone_gas_run,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     db.install_filter(make_shared<Filter>(&i));
@@ -146,7 +148,9 @@ TEST(iteration_stop_gas) {
         should_run: &filter_yes_run,
         init: &iteration_stop_gas_init,
         destroy: &iteration_stop_gas_destroy,
-        run: &iteration_stop_gas_run
+        run: &iteration_stop_gas_run,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     db.install_filter(make_shared<Filter>(&i));
@@ -243,7 +247,9 @@ TEST(max_val) {
         should_run: &max_val_should_run,
         init: &max_val_gas_init,
         destroy: &max_val_gas_destroy,
-        run: &max_val_gas_run
+        run: &max_val_gas_run,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     db.install_filter(make_shared<Filter>(&i));
@@ -1,6 +1,7 @@
 #include "test.hpp"
 #include "pando_map.hpp"
 #include "pando_map_client.hpp"
+#include "pando_map_local.hpp"
 #include "par_db.hpp"
 #include "par_db_thread.hpp"
 #include <chrono>
@@ -302,6 +303,211 @@ TEST(large_msg) {
 
 }
 
+TEST(local_backend) {
+    ZMQAddress map_addr {"127.0.0.1", ++g_idx};
+    ParDBThread<PandoMap> m {map_addr};
+    PandoMapLocal l {m.get()};
+    PandoMapClient c {map_addr, map_addr};
+
+    EQ(l.size(), 0);
+
+    DBEntry<> e;
+    e.value() = "testing123";
+    dbkey_t k {2,2,3};
+    e.set_key(k);
+    e.add_tag("test1");
+    e.add_tag("test2");
+    l.insert(move(e));
+
+    // Both backends see the same map
+    EQ(l.size(), 1);
+    EQ(c.size(), 1);
+    EQ(l.key_exist(k), true);
+    EQ(c.key_exist(k), true);
+
+    DBEntry<> e_ret = c.retrieve(k);
+    EQ(e_ret.value(), "testing123");
+    EQ(e_ret.has_tag("test1"), true);
+    EQ(e_ret.has_tag("test2"), true);
+    EQ(e_ret.get_key(), k);
+
+    // Replacing an entry reuses its slot
+    e_ret.value() = "testing321";
+    e_ret.remove_tag("test2");
+    l.insert(move(e_ret));
+    EQ(l.size(), 1);
+
+    auto [e_local, exists] = l.retrieve_if_exists(k);
+    EQ(exists, true);
+    EQ(e_local.value(), "testing321");
+    EQ(e_local.has_tag("test2"), false);
+    EQ(e_local.tag_size(), 1);
+
+    dbkey_t bad_key {1,1,1};
+    auto [e_bad, bad_exists] = l.retrieve_if_exists(bad_key);
+    EQ(bad_exists, false);
+    EQ(l.key_exist(bad_key), false);
+
+    // Visiting points directly at the stored entry
+    bool visited = false;
+    EQ(l.visit(k, [&](const DBAccess& access) {
+        visited = (string{access.value} == "testing321") && (access.key == k);
+    }), true);
+    EQ(visited, true);
+    EQ(l.visit(bad_key, [&](const DBAccess&) { visited = false; }), false);
+    EQ(visited, true);
+
+    EQ(l.keys().size(), 1);
+    EQ(l.retrieve_all_entries().size(), 1);
+
+    TEST_PASS
+}
+
+TEST(scan_batches) {
+    ZMQAddress map_addr {"127.0.0.1", ++g_idx};
+    ParDBThread<PandoMap> m {map_addr};
+    PandoMapClient c {map_addr, map_addr};
+
+    size_t num_entries = 2500;
+    for (size_t i=0; i < num_entries; i++) {
+        DBEntry e;
+        dbkey_t k {1,1,boost::numeric_cast<vtx_t>(i)};
+        e.set_key(k);
+        e.value() = to_string(i);
+        c.insert(move(e));
+    }
+
+    // Every entry is returned exactly once, across multiple batches
+    map<dbkey_t, int> seen;
+    auto entries = c.scan_entries(100);
+    for (auto & entry : entries) {
+        EQ(entry.value(), to_string(entry.get_key().c));
+        ++seen[entry.get_key()];
+    }
+    EQ(seen.size(), num_entries);
+    for (auto & [key, count] : seen)
+        EQ(count, 1);
+
+    // The client stays usable during a scan, and scans can stop early
+    size_t num_visited = 0;
+    bool all_exist = true;
+    c.scan([&](const DBAccess& access) {
+        all_exist &= c.key_exist(access.key);
+        return ++num_visited < 10;
+    });
+    EQ(num_visited, 10);
+    EQ(all_exist, true);
+
+    // A scan over an empty map finishes immediately
+    ZMQAddress empty_addr {"127.0.0.1", ++g_idx};
+    ParDBThread<PandoMap> m_empty {empty_addr};
+    PandoMapClient c_empty {empty_addr, empty_addr};
+    auto no_entries = c_empty.scan_entries();
+    for ([[maybe_unused]] auto & entry : no_entries)
+        TEST_FAIL
+
+    TEST_PASS
+}
+
+TEST(compact) {
+    ZMQAddress addr {"127.0.0.1", ++g_idx};
+    PandoMap m {addr};
+
+    const vtx_t NUM_ENTRIES = 100;
+    for (vtx_t i = 0; i < NUM_ENTRIES; ++i) {
+        DBEntry e;
+        e.set_key({0, 0, i});
+        e.add_tag("test");
+        e.value() = string(100, 'a');
+        m.assign(e);
+        // Replacing with a larger value leaves the old one behind
+        e.value() = string(300, 'b');
+        m.assign(e);
+    }
+
+    auto & space = m.space();
+    EQ(space.live(), (size_t)NUM_ENTRIES*301);
+    EQ(space.fragmented() > 0, true);
+
+    m.compact();
+
+    auto & fresh = m.space();
+    EQ(fresh.live(), (size_t)NUM_ENTRIES*301);
+    EQ(fresh.used(), (size_t)NUM_ENTRIES*301);
+    EQ(fresh.fragmented(), 0);
+    EQ(m.size(), (size_t)NUM_ENTRIES);
+    for (vtx_t i = 0; i < NUM_ENTRIES; ++i) {
+        auto e = m.find({0, 0, i});
+        EQ(e->has_tag("test"), true);
+        EQ(e->value(), string(300, 'b').c_str());
+    }
+
+    TEST_PASS
+}
+
+TEST(modify_in_place) {
+    ZMQAddress map_addr {"127.0.0.1", ++g_idx};
+    ParDBThread<PandoMap> m {map_addr};
+    PandoMapLocal l {m.get()};
+    PandoMapClient c {map_addr, map_addr};
+
+    DBEntry<> e;
+    e.value() = string(100, 'a');
+    dbkey_t k {2,2,3};
+    e.set_key(k);
+    e.add_tag("test1");
+    l.insert(move(e));
+
+    const char* value_ptr = m.get().find(k)->value().c_str();
+
+    // Changing tags leaves the stored value where it is
+    l.add_tags(k, {"test2", "test3"});
+    c.add_tags(k, {"test4"});
+    c.remove_tags(k, {"test1"});
+    l.remove_tags(k, {"test3"});
+    auto stored = m.get().find(k);
+    NOPRINT_EQ(stored->value().c_str(), value_ptr);
+    EQ(stored->has_tag("test1"), false);
+    EQ(stored->has_tag("test2"), true);
+    EQ(stored->has_tag("test3"), false);
+    EQ(stored->has_tag("test4"), true);
+
+    // A value that fits reuses the storage
+    c.set_value(k, string(50, 'b'));
+    NOPRINT_EQ(stored->value().c_str(), value_ptr);
+    EQ(c.retrieve(k).value(), string(50, 'b'));
+    l.set_value(k, "short");
+    EQ(l.retrieve(k).value(), "short");
+
+    // Batches apply in order, over either backend
+    dbkey_t k2 {2,2,4};
+    DBEntry<> e2;
+    e2.set_key(k2);
+    l.insert(move(e2));
+    vector<MapModification> mods {
+        {MapModification::ADD_TAG, k, "test5"},
+        {MapModification::SET_VALUE, k2, "value2"},
+        {MapModification::ADD_TAG, k2, "test6"},
+        {MapModification::REMOVE_TAG, k, "test5"},
+    };
+    c.modify_multiple(mods);
+    EQ(c.retrieve(k).has_tag("test5"), false);
+    EQ(c.retrieve(k2).value(), "value2");
+    EQ(c.retrieve(k2).has_tag("test6"), true);
+
+    mods = {{MapModification::ADD_TAG, k, "test7"}};
+    l.modify_multiple(mods);
+    EQ(l.retrieve(k).has_tag("test7"), true);
+
+    // The entry must already exist
+    try {
+        l.add_tags({1,1,1}, {"test"});
+        TEST_FAIL
+    } catch (const runtime_error&) { }
+
+    TEST_PASS
+}
+
 TESTS_BEGIN
     elga::ZMQChatterbox::Setup();
     RUN_TEST(insert_retrieve)
@@ -314,5 +520,9 @@ TESTS_BEGIN
     RUN_TEST(retrieve_if_exists)
     RUN_TEST(insert_multiple)
     RUN_TEST(large_msg)
+    RUN_TEST(local_backend)
+    RUN_TEST(scan_batches)
+    RUN_TEST(compact)
+    RUN_TEST(modify_in_place)
     elga::ZMQChatterbox::Teardown();
 TESTS_END
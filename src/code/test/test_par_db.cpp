@@ -1,6 +1,7 @@
 #include "test.hpp"
 #include "par_db.hpp"
 #include "par_db_responder.hpp"
+#include "par_db_query.hpp"
 #include "test_helpers.hpp"
 
 #include <chrono>
@@ -962,6 +963,71 @@ TEST(import_export) {
     TEST_PASS
 }
 
+TEST(import_export_routed) {
+    set<dbkey_t> orig_keys;
+    {
+        elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+        ParDBThread<ParDB> db1 { db1_addr };
+        ParDBClient c1 { db1_addr };
+
+        elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+        ParDBThread<ParDB> db2 { db2_addr };
+        ParDBClient c2 { db2_addr };
+
+        c1.add_neighbor(db2_addr);
+        this_thread::sleep_for(chrono::milliseconds(50));
+        EQ(c1.num_neighbors(), 2);
+
+        for (vtx_t i = 0; i < 50; ++i) {
+            dbkey_t key {1, i, 3};
+            DBEntry<> e; e.add_tag("a").value() = to_string(i); e.set_key(key);
+            c1.add_entry(e);
+            orig_keys.insert(key);
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+        EQ(c1.db_size() + c2.db_size(), 50);
+
+        mkdir("export_routed", 0777);
+        c1.export_db("export_routed");
+    }
+
+    // Import into a larger mesh, with one agent reading every file
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db1 { db1_addr };
+    ParDBClient c1 { db1_addr };
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db2 { db2_addr };
+    ParDBClient c2 { db2_addr };
+    elga::ZMQAddress db3_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db3 { db3_addr };
+    ParDBClient c3 { db3_addr };
+
+    c1.add_neighbor(db2_addr);
+    c1.add_neighbor(db3_addr);
+    this_thread::sleep_for(chrono::milliseconds(50));
+    EQ(c1.num_neighbors(), 3);
+
+    c2.import_db("export_routed", true);
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    EQ(c1.db_size() + c2.db_size() + c3.db_size(), 50);
+    NOPRINT_EQ(c1.db_size() > 0 && c2.db_size() > 0 && c3.db_size() > 0, true);
+
+    set<dbkey_t> found_keys;
+    for (auto * c : {&c1, &c2, &c3}) {
+        for (auto & entry : c->get_entries()) {
+            EQ(entry.has_tag("a"), true);
+            EQ(entry.value(), to_string(entry.get_key().b));
+            NOPRINT_EQ(found_keys.insert(entry.get_key()).second, true);
+        }
+    }
+    NOPRINT_EQ(found_keys == orig_keys, true);
+
+    std::filesystem::remove_all("export_routed");
+
+    TEST_PASS
+}
+
 TEST(query_entries_all_neighbors) {
     g_idx = 0;
 
@@ -1067,6 +1133,160 @@ TEST(query_multiple_tags) {
 
 }
 
+TEST(query_pages) {
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db1 { db1_addr };
+    ParDBClient c1 { db1_addr };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db2 { db2_addr };
+    ParDBClient c2 { db2_addr };
+
+    c1.add_neighbor(db2_addr);
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    for (vtx_t i = 0; i < 20; ++i) {
+        DBEntry<> e; dbkey_t key {0,i,1}; e.set_key(key);
+        e.add_tag("BTC", i % 2 == 0 ? "A" : "B");
+        e.value() = "value" + to_string(i);
+        c1.add_entry(e);
+    }
+    EQ(c1.db_size() + c2.db_size(), 20);
+
+    // Every entry arrives once, in bounded pages
+    {
+        ParDBQuery query { c1.neighbors(), {"BTC", "A"}, 3 };
+        set<vtx_t> seen;
+        vector<DBEntry<>> page;
+        while (query.next_page(page)) {
+            EQ(page.size() <= 3, true);
+            for (auto & e : page) {
+                EQ(e.has_tag("A"), true);
+                EQ(e.value(), "value" + to_string(e.get_key().b));
+                seen.insert(e.get_key().b);
+            }
+        }
+        EQ(seen.size(), 10);
+        EQ(query.next_page(page), false);
+    }
+
+    // Keys only, and value prefixes
+    {
+        ParDBQuery query { c1.neighbors(), {"BTC"}, 4, 0 };
+        size_t n = 0;
+        vector<DBEntry<>> page;
+        while (query.next_page(page)) {
+            for (auto & e : page) {
+                EQ(e.tag_size(), 0);
+                EQ(e.value(), "");
+                ++n;
+            }
+        }
+        EQ(n, 20);
+    }
+    {
+        ParDBQuery query { c1.neighbors(), {"BTC"}, 4, QUERY_VALUE, 3 };
+        vector<DBEntry<>> page;
+        while (query.next_page(page)) {
+            for (auto & e : page) {
+                EQ(e.tag_size(), 0);
+                EQ(e.value(), "val");
+            }
+        }
+    }
+
+    // A closed query has no more pages
+    uint64_t cursor;
+    auto page = c1.query_page({"BTC"}, cursor, 1);
+    EQ(page.size(), 1);
+    NOTEQ(cursor, 0);
+    c1.query_close(cursor);
+    try {
+        c1.query_next(cursor, 1);
+        TEST_FAIL
+    } catch (const runtime_error&) {}
+
+    // A query read to the end closes itself
+    auto all = c1.query_page({"BTC"}, cursor, 100);
+    EQ(all.size(), c1.db_size());
+    EQ(cursor, 0);
+
+    // Abandoning a query part way through closes it on every agent
+    {
+        ParDBQuery query { c1.neighbors(), {"BTC"}, 1 };
+        EQ(query.next_page(page), true);
+    }
+
+    TEST_PASS
+}
+
+TEST(aggregate_all_neighbors) {
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db1 { db1_addr };
+    ParDBClient c1 { db1_addr };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db2 { db2_addr };
+    ParDBClient c2 { db2_addr };
+
+    c1.add_neighbor(db2_addr);
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    for (vtx_t i = 0; i < 20; ++i) {
+        DBEntry<> e; dbkey_t key {0,i,1}; e.set_key(key);
+        e.add_tag("out_val_usd", i < 10 ? "month=01" : "month=02");
+        e.value() = to_string(i);
+        c1.add_entry(e);
+    }
+    // Both agents hold part of the result
+    NOTEQ(c1.aggregate({"out_val_usd"})[""].count, 20);
+    NOTEQ(c2.aggregate({"out_val_usd"})[""].count, 20);
+
+    auto by_month = aggregate_all(c1.neighbors(), {"out_val_usd"}, "month=");
+    EQ(by_month.size(), 2);
+    EQ(by_month["01"].count, 10);
+    FEQ(by_month["01"].sum, 45);
+    FEQ(by_month["01"].min, 0);
+    EQ(by_month["02"].count, 10);
+    FEQ(by_month["02"].sum, 145);
+    FEQ(by_month["02"].max, 19);
+
+    TEST_PASS
+}
+
+TEST(merge_strategy_all_neighbors) {
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db1 { db1_addr };
+    ParDBClient c1 { db1_addr };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread<ParDB> db2 { db2_addr };
+    ParDBClient c2 { db2_addr };
+
+    c1.add_neighbor(db2_addr);
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    c1.set_merge_strategy(~0ull, 5, MERGE_STRATEGY_SUM);
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    // Keys owned by both agents are summed
+    for (size_t n = 0; n < 3; ++n) {
+        for (vtx_t i = 0; i < 10; ++i) {
+            DBEntry<> e; dbkey_t key {5,i,1}; e.set_key(key);
+            e.add_tag("count");
+            e.value() = "2";
+            c1.add_entry(e);
+        }
+    }
+
+    EQ(c1.db_size() + c2.db_size(), 10);
+    for (auto & c : {&c1, &c2})
+        for (auto & e : c->get_entries())
+            EQ(e.value(), "6");
+
+    TEST_PASS
+}
+
 TEST(import_txt_db) {
     elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
     ParDBThread<ParDB> db1 { db1_addr };
@@ -1106,9 +1326,13 @@ TESTS_BEGIN
     RUN_TEST(get_neighbors)
     RUN_TEST(processing)
     RUN_TEST(import_export)
+    RUN_TEST(import_export_routed)
     RUN_TEST(query_entries_all_neighbors)
     RUN_TEST(query_entries_all_neighbors_after_filter)
     RUN_TEST(query_multiple_tags)
+    RUN_TEST(query_pages)
+    RUN_TEST(aggregate_all_neighbors)
+    RUN_TEST(merge_strategy_all_neighbors)
 
     RUN_TEST(add_entry_single)
     RUN_TEST(add_entry_multiple)
@@ -139,6 +139,55 @@ TEST(filter_new_entry_with_key) {
     TEST_PASS
 }
 
+TEST(filter_sum_entries) {
+    g_idx = 1;
+
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db1 { db1_addr };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db2 { db2_addr };
+
+    ParDBClient c1 { db1_addr };
+    ParDBClient c2 { db2_addr };
+
+    vector<ZMQAddress> addrs; addrs.push_back(db1_addr); addrs.push_back(db2_addr);
+
+    c1.add_neighbor(db2_addr);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    c1.add_filter_dir(build_dir+"/test/filters");
+    this_thread::sleep_for(chrono::milliseconds(50));
+    c1.install_filter("test_pardb_filters_sum");
+
+    // Entries on both agents count into the same keys
+    size_t num_entries = 20;
+    for (vtx_t i = 0; i < num_entries; ++i) {
+        DBEntry<> e; e.set_key({1,i,3});
+        e.add_tag("A").add_to_value("test");
+        c1.add_entry(e);
+    }
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    c1.process();
+    wait(addrs);
+
+    EQ(c1.db_size()+c2.db_size(), num_entries+4);
+
+    size_t counts = 0;
+    for (auto & c : {&c1, &c2}) {
+        for (auto & e : c->query("count")) {
+            EQ(e.value(), to_string(3*num_entries));
+            EQ(e.has_tag("MERGED_SUM"), true);
+            ++counts;
+        }
+    }
+    EQ(counts, 4);
+
+    TEST_PASS
+}
+
 TEST(filter_fail) {
     elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
     ParDBThread db1 { db1_addr };
@@ -461,6 +510,130 @@ TEST(filter_get_entry_two_db_not_found) {
     TEST_PASS
 }
 
+TEST(filter_get_entries_two_db) {
+    g_idx = 7;
+
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db1 { db1_addr };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db2 { db2_addr };
+
+    ParDBClient c1 { db1_addr };
+    ParDBClient c2 { db2_addr };
+
+    vector<ZMQAddress> addrs; addrs.push_back(db1_addr); addrs.push_back(db2_addr);
+
+    c1.add_neighbor(db2_addr);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    EQ(c1.num_neighbors(), 2);
+    EQ(c2.num_neighbors(), 2);
+
+    DBEntry<> e1;
+    e1.add_tag("A");
+    e1.value() = "test1";
+    dbkey_t key1 {2,2,4};
+    e1.set_key(key1);
+    c1.add_entry(e1);
+
+    DBEntry<> e2;
+    e2.add_tag("B");
+    e2.value() = "test2";
+    dbkey_t key2 {2,4,4};
+    e2.set_key(key2);
+    c1.add_entry(e2);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+    // One key is on each agent, so both are asked
+    EQ(c1.db_size(), 1);
+    EQ(c2.db_size(), 1);
+
+    c1.add_filter_dir(build_dir+"/test/filters");
+    c1.install_filter("test_pardb_filters_get_entries");
+    c1.process();
+    wait(addrs);
+
+    bool a_entry_found = false;
+    for (auto &entry : c1.get_entries()) {
+        if (entry.has_tag("test_pardb_filters_get_entries:done")) {
+            EQ(a_entry_found, false)
+            a_entry_found = true;
+        } else {
+            TEST_FAIL
+        }
+    }
+    EQ(a_entry_found, true);
+
+    TEST_PASS
+}
+
+TEST(filter_hot_key_replica_two_db) {
+    g_idx = 7;
+
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db1 { db1_addr };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db2 { db2_addr };
+
+    ParDBClient c1 { db1_addr };
+    ParDBClient c2 { db2_addr };
+
+    vector<ZMQAddress> addrs; addrs.push_back(db1_addr); addrs.push_back(db2_addr);
+
+    c1.add_neighbor(db2_addr);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    DBEntry<> hot;
+    hot.add_tag("K");
+    hot.value() = "v1";
+    hot.set_key({2,4,4});
+    c1.add_entry(hot);
+
+    // Enough readers that the key becomes hot on both agents
+    const size_t num_readers = 400;
+    for (size_t i = 0; i < num_readers; ++i) {
+        DBEntry<> e;
+        e.add_tag("A");
+        if (i == 0) e.add_tag("W");
+        e.set_key({3,(vtx_t)i,0});
+        c1.add_entry(e);
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+    EQ(c1.db_size()+c2.db_size(), num_readers+1);
+
+    c1.add_filter_dir(build_dir+"/test/filters");
+    c1.install_filter("test_pardb_filters_replica");
+    c1.process();
+    wait(addrs);
+
+    // Each write to the hot key must reach the readers by the next stage,
+    // replica or not
+    size_t readers_done = 0;
+    bool hot_found = false;
+    for (auto * c : {&c1, &c2}) {
+        for (auto &entry : c->get_entries()) {
+            if (entry.has_tag("K")) {
+                EQ(entry.value(), "v3");
+                hot_found = true;
+            } else {
+                EQ(entry.has_tag("seen:v1"), true);
+                EQ(entry.has_tag("seen:v2"), true);
+                EQ(entry.has_tag("seen:v3"), true);
+                ++readers_done;
+            }
+        }
+    }
+    EQ(hot_found, true);
+    EQ(readers_done, num_readers);
+
+    TEST_PASS
+}
+
 TEST(filter_get_entry) {
     g_idx = 10;
 
@@ -616,6 +789,105 @@ TEST(filter_subscribe_two_db) {
     TEST_PASS
 }
 
+TEST(filter_subscribe_two_db_incremental) {
+    // As above, but each stage only checks the entries that changed, so the
+    // waiting entry must be woken by its subscription
+    g_idx = 7;
+
+    elga::ZMQAddress db1_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db1 { db1_addr, 2ull*(1ull<<29), false, false, 0, 1, true };
+
+    elga::ZMQAddress db2_addr { "127.0.0.1", g_idx+=inc_amount };
+    ParDBThread db2 { db2_addr, 2ull*(1ull<<29), false, false, 0, 1, true };
+
+    vector<ZMQAddress> addrs; addrs.push_back(db1_addr); addrs.push_back(db2_addr);
+
+    ParDBClient c1 { db1_addr };
+    ParDBClient c2 { db2_addr };
+
+    c1.add_neighbor(db2_addr);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    EQ(c1.num_neighbors(), 2);
+    EQ(c2.num_neighbors(), 2);
+
+    DBEntry<> e1;
+    e1.clear().add_tag("A");
+    e1.value() = "test1";
+    dbkey_t key1 {2,2,4};
+    e1.set_key(key1);
+    c1.add_entry(e1);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    EQ(c1.db_size(), 1);
+    EQ(c2.db_size(), 0);
+
+    c1.add_filter_dir(build_dir+"/test/filters");
+    c1.install_filter("test_pardb_filters_subscribe");
+
+    //Run the filter and make it subscribe because the entry it's looking for does not exist
+    c1.process();
+    wait(addrs);
+
+    //Ensure the db state is correct
+    EQ(c1.db_size(), 1);
+    EQ(c2.db_size(), 0);
+    bool wait_tag_found = false;
+    for (auto &entry : c1.get_entries()) {
+        if (entry.has_tag("wait"))
+            wait_tag_found = true;
+    }
+    EQ(wait_tag_found, true);
+
+    //Add the entry that it subscribed to
+    DBEntry<> e2;
+    e2.clear().add_tag("B");
+    e2.value() = "test2";
+    dbkey_t key2 {2,4,4};
+    e2.set_key(key2);
+    c1.add_entry(e2);
+
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    // process once after adding the entry to ensure the subscriptions are
+    // finished properly
+    c1.process(); wait(addrs);
+
+    //And process again
+    c1.process();
+    wait(addrs);
+
+    EQ(c1.db_size(), 1);
+    EQ(c2.db_size(), 1);
+
+    bool a_entry_found = false;
+    bool b_entry_found = false;
+    for (auto &entry : c1.get_entries()) {
+        EQ(entry.has_tag("wait"), false);
+        if (entry.has_tag("test_pardb_filters_subscribe:done")) {
+            EQ(a_entry_found, false)
+            a_entry_found = true;
+        } else {
+            TEST_FAIL
+        }
+    }
+    for (auto &entry : c2.get_entries()) {
+        EQ(entry.has_tag("wait"), false);
+        if (entry.has_tag("B")) {
+            EQ(b_entry_found, false)
+            b_entry_found = true;
+        } else {
+            TEST_FAIL
+        }
+    }
+    EQ(a_entry_found, true);
+    EQ(b_entry_found, true);
+
+    TEST_PASS
+}
+
 TEST(filter_remove_tag_two_db) {
     g_idx = 7;
 
@@ -908,6 +1180,7 @@ TESTS_BEGIN
 
     RUN_TEST(filter_new_entry)
     RUN_TEST(filter_new_entry_with_key)
+    RUN_TEST(filter_sum_entries)
     RUN_TEST(filter_fail)
     RUN_TEST(dup_filters_fail)
     RUN_TEST(two_filters)
@@ -918,7 +1191,10 @@ TESTS_BEGIN
     RUN_TEST(filter_get_entry)
     RUN_TEST(filter_get_entry_two_db)
     RUN_TEST(filter_get_entry_two_db_not_found)
+    RUN_TEST(filter_get_entries_two_db)
+    RUN_TEST(filter_hot_key_replica_two_db)
     RUN_TEST(filter_subscribe_two_db)
+    RUN_TEST(filter_subscribe_two_db_incremental)
     RUN_TEST(filter_remove_tag_two_db)
 
     RUN_TEST(in_out_edges_bad_order)
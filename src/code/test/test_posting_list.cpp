@@ -0,0 +1,106 @@
+#include "test.hpp"
+
+#include <set>
+
+#include "posting_list.hpp"
+
+using namespace std;
+using namespace pando;
+
+/** @brief Return the ids of a list, in order */
+vector<uint32_t> ids(const PostingList& l) {
+    vector<uint32_t> ret;
+    l.for_each([&](uint32_t id) { ret.push_back(id); });
+    return ret;
+}
+
+TEST(add_remove) {
+    PostingList l;
+    EQ(l.empty(), true);
+    EQ(l.add(5), true);
+    EQ(l.add(5), false);
+    EQ(l.add(1<<20), true);
+    EQ(l.add(3), true);
+    EQ(l.cardinality(), 3);
+    EQ(l.contains(5), true);
+    EQ(l.contains(4), false);
+    EQ(l.contains(1<<20), true);
+
+    vector<uint32_t> expected {3, 5, 1<<20};
+    EQ(ids(l) == expected, true);
+
+    EQ(l.remove(5), true);
+    EQ(l.remove(5), false);
+    EQ(l.remove(1<<20), true);
+    EQ(l.cardinality(), 1);
+    EQ(l.contains(3), true);
+
+    TEST_PASS
+}
+
+TEST(dense) {
+    // Enough ids in one container to hold it as a bitmap, and back again
+    PostingList l;
+    const uint32_t n = 3*PostingList::ARRAY_MAX;
+    for (uint32_t id = 0; id < n; ++id) l.add(2*id);
+    EQ(l.cardinality(), n);
+    EQ(l.contains(2*(n-1)), true);
+    EQ(l.contains(1), false);
+
+    for (uint32_t id = 0; id < n; id += 2) l.remove(2*id);
+    EQ(l.cardinality(), n/2);
+    EQ(l.contains(0), false);
+    EQ(l.contains(2), true);
+
+    auto got = ids(l);
+    EQ(got.size(), n/2);
+    EQ(is_sorted(got.begin(), got.end()), true);
+
+    TEST_PASS
+}
+
+TEST(intersect_subtract) {
+    // Check every mix of sparse and dense containers against std::set
+    auto fill = [](PostingList& l, set<uint32_t>& s, uint32_t base, uint32_t step, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+            l.add(base+i*step);
+            s.insert(base+i*step);
+        }
+    };
+    PostingList a, b;
+    set<uint32_t> sa, sb;
+    // Container 0: both sparse, container 1: a dense and b sparse,
+    // container 2: a sparse and b dense, container 3: both dense
+    fill(a, sa, 0, 3, 1000);        fill(b, sb, 0, 2, 1000);
+    fill(a, sa, 1<<16, 3, 10000);   fill(b, sb, 1<<16, 7, 100);
+    fill(a, sa, 2<<16, 5, 100);     fill(b, sb, 2<<16, 2, 10000);
+    fill(a, sa, 3<<16, 2, 20000);   fill(b, sb, 3<<16, 3, 20000);
+    // Only in a
+    fill(a, sa, 5<<16, 1, 10);
+
+    vector<uint32_t> both, only_a;
+    set_intersection(sa.begin(), sa.end(), sb.begin(), sb.end(), back_inserter(both));
+    set_difference(sa.begin(), sa.end(), sb.begin(), sb.end(), back_inserter(only_a));
+
+    PostingList i = a;
+    i.intersect_with(b);
+    EQ(i.cardinality(), both.size());
+    EQ(ids(i) == both, true);
+
+    PostingList d = a;
+    d.subtract(b);
+    EQ(d.cardinality(), only_a.size());
+    EQ(ids(d) == only_a, true);
+
+    PostingList empty;
+    i.intersect_with(empty);
+    EQ(i.empty(), true);
+
+    TEST_PASS
+}
+
+TESTS_BEGIN
+    RUN_TEST(add_remove)
+    RUN_TEST(dense)
+    RUN_TEST(intersect_subtract)
+TESTS_END
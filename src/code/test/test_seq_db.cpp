@@ -342,6 +342,8 @@ TEST(access_tags) {
     EQ(db.get_entry_by_tags({"a", "b"}).size(), 1);
     // Make sure {a,b,c} does not find anything
     EQ(db.get_entry_by_tags({"a", "b", "c"}).size(), 0);
+    EQ(db.count_entries_by_tags({"a", "b"}), 1);
+    EQ(db.count_entries_by_tags({"a", "b", "c"}), 0);
 
     acc->add_tag.run(&acc->add_tag, "c");
 
@@ -625,7 +627,9 @@ TEST(install_filter_fi) {
         should_run: &g_TEST_install_filter_fi_sroe,
         init: nullptr,
         destroy: nullptr,
-        run: &g_TEST_install_filter_fi_run
+        run: &g_TEST_install_filter_fi_run,
+        predicate: nullptr,
+        thread_safe: false
     };
 
     SeqDB d;
@@ -646,6 +650,243 @@ TEST(install_filter_fi) {
     TEST_PASS
 }
 
+TEST(install_filter_fi_ipc) {
+    // Same as above, but scanning the database over ZMQ in batches
+    g_TEST_install_filter_fi_pass = 0;
+    FilterInterface i {
+        filter_name: "TEST",
+        filter_type: SINGLE_ENTRY,
+        should_run: &g_TEST_install_filter_fi_sroe,
+        init: nullptr,
+        destroy: nullptr,
+        run: &g_TEST_install_filter_fi_run,
+        predicate: nullptr,
+        thread_safe: false
+    };
+
+    SeqDB d;
+    d.use_ipc_map(true);
+    { DBEntry<> e; e.clear().add_tag("A"); d.add_entry(e); }
+    { DBEntry<> e; e.clear().add_tag("B"); d.add_entry(e); }
+    { DBEntry<> e; e.clear().add_tag("A", "C"); d.add_entry(e); }
+    { DBEntry<> e;  e.clear().add_tag("D", "C"); d.add_entry(e); }
+    { DBEntry<> e; e.clear().add_tag("E"); d.add_entry(e); }
+    { DBEntry<> e; e.clear().add_tag("A"); d.add_entry(e); }
+
+    filter_p fp = make_shared<Filter>(&i);
+
+    d.install_filter(fp);
+    d.process_once();
+    EQ(g_TEST_install_filter_fi_pass, 3);
+
+    TEST_PASS
+}
+
+static int g_TEST_install_filter_predicate_checked;
+bool g_TEST_install_filter_predicate_sroe([[maybe_unused]] const DBAccess* acc) {
+    ++g_TEST_install_filter_predicate_checked;
+    return true;
+}
+
+TEST(install_filter_predicate) {
+    const char* required_tags[] = {"A", ""};
+    const char* forbidden_tags[] = {"C", ""};
+    FilterPredicate p {
+        required_tags: required_tags,
+        forbidden_tags: forbidden_tags,
+        key_a_mask: 0,
+        key_a_value: 0
+    };
+    FilterInterface i {
+        filter_name: "TEST",
+        filter_type: SINGLE_ENTRY,
+        should_run: &g_TEST_install_filter_predicate_sroe,
+        init: nullptr,
+        destroy: nullptr,
+        run: &g_TEST_install_filter_fi_run,
+        predicate: &p,
+        thread_safe: false
+    };
+
+    SeqDB d;
+    { DBEntry<> e; e.clear().add_tag("A"); e.set_key({1,1,1}); d.add_entry(move(e)); }
+    { DBEntry<> e; e.clear().add_tag("B"); e.set_key({1,2,2}); d.add_entry(move(e)); }
+    { DBEntry<> e; e.clear().add_tag("A", "C"); e.set_key({1,3,3}); d.add_entry(move(e)); }
+    { DBEntry<> e; e.clear().add_tag("D", "C"); e.set_key({1,4,4}); d.add_entry(move(e)); }
+    { DBEntry<> e; e.clear().add_tag("E"); e.set_key({1,5,5}); d.add_entry(move(e)); }
+    { DBEntry<> e; e.clear().add_tag("A"); e.set_key({2,6,6}); d.add_entry(move(e)); }
+
+    filter_p fp = make_shared<Filter>(&i);
+    d.install_filter(fp);
+
+    // should_run is only called on the candidates
+    g_TEST_install_filter_fi_pass = 0;
+    g_TEST_install_filter_predicate_checked = 0;
+    d.process_once();
+    EQ(g_TEST_install_filter_predicate_checked, 2);
+    EQ(g_TEST_install_filter_fi_pass, 2);
+
+    // Narrow down by key too
+    p.key_a_mask = ~0ull;
+    p.key_a_value = 2;
+    g_TEST_install_filter_fi_pass = 0;
+    g_TEST_install_filter_predicate_checked = 0;
+    d.process_once();
+    EQ(g_TEST_install_filter_predicate_checked, 1);
+    EQ(g_TEST_install_filter_fi_pass, 1);
+
+    // A forced merge keeps only the stored entry's tags, so the index must
+    // not keep the merged-in tags
+    p.key_a_mask = 0;
+    p.key_a_value = 0;
+    { DBEntry<> e; e.clear().add_tag("F", MERGE_STRATEGY_FORCE); e.set_key({3,7,7}); d.add_entry(move(e)); }
+    { DBEntry<> e; e.clear().add_tag("A", MERGE_STRATEGY_FORCE); e.set_key({3,7,7}); d.add_entry(move(e)); }
+    g_TEST_install_filter_predicate_checked = 0;
+    d.process_once();
+    EQ(g_TEST_install_filter_predicate_checked, 2);
+
+    TEST_PASS
+}
+
+bool g_TEST_filter_threads_sroe([[maybe_unused]] const DBAccess* acc) {
+    return true;
+}
+void g_TEST_filter_threads_run(void* access_raw) {
+    DBAccess* access = (DBAccess*)access_raw;
+    access->add_tag.run(&access->add_tag, "A:done");
+
+    const char* const new_tags[] = {"B", ""};
+    dbkey_t new_key {2, access->key.b, 0};
+    access->make_new_entry.run(&access->make_new_entry, new_tags, access->value, new_key);
+
+    string new_value = string("x") + access->value;
+    access->update_entry_val.run(&access->update_entry_val, access->key, new_value.c_str());
+}
+
+TEST(filter_threads) {
+    const char* required_tags[] = {"A", ""};
+    const char* forbidden_tags[] = {"A:done", ""};
+    FilterPredicate p {
+        required_tags: required_tags,
+        forbidden_tags: forbidden_tags,
+        key_a_mask: 0,
+        key_a_value: 0
+    };
+    FilterInterface i {
+        filter_name: "TEST",
+        filter_type: SINGLE_ENTRY,
+        should_run: &g_TEST_filter_threads_sroe,
+        init: nullptr,
+        destroy: nullptr,
+        run: &g_TEST_filter_threads_run,
+        predicate: &p,
+        thread_safe: true
+    };
+
+    const vtx_t num_entries = 5000;
+    SeqDB d;
+    d.set_filter_threads(4);
+    for (vtx_t k = 0; k < num_entries; ++k) {
+        DBEntry<> e; e.add_tag("A").value() = to_string(k); e.set_key({1,k,0});
+        d.add_entry(move(e));
+    }
+
+    d.install_filter(make_shared<Filter>(&i));
+    EQ(d.process_once(), true);
+    EQ(d.size(), (size_t)(2*num_entries));
+
+    size_t done = 0, created = 0;
+    for (auto & [key, entry] : d.entries()) {
+        if (key.a == 1) {
+            NOPRINT_EQ(entry.has_tag("A:done"), true);
+            NOPRINT_EQ(entry.value(), "x" + to_string(key.b));
+            ++done;
+        } else {
+            NOPRINT_EQ(entry.has_tag("B"), true);
+            NOPRINT_EQ(entry.value(), to_string(key.b));
+            ++created;
+        }
+    }
+    EQ(done, (size_t)num_entries);
+    EQ(created, (size_t)num_entries);
+
+    // Everything is done, so nothing runs again
+    EQ(d.process_once(), false);
+
+    TEST_PASS
+}
+
+size_t g_TEST_incremental_checks = 0;
+bool g_TEST_incremental_sroe(const DBAccess* acc) {
+    ++g_TEST_incremental_checks;
+    bool a = false, done = false;
+    for (auto tags = acc->tags; *tags[0] != '\0'; ++tags) {
+        if (strcmp(*tags, "A") == 0) a = true;
+        if (strcmp(*tags, "A:done") == 0) done = true;
+    }
+    return a && !done;
+}
+void g_TEST_incremental_run(void* access_raw) {
+    DBAccess* access = (DBAccess*)access_raw;
+    access->add_tag.run(&access->add_tag, "A:done");
+
+    // Each entry starts the next, up to 3
+    vtx_t step = stoul(access->value);
+    if (step == 3) return;
+    const char* const new_tags[] = {"A", ""};
+    string new_value = to_string(step+1);
+    access->make_new_entry.run(&access->make_new_entry, new_tags, new_value.c_str(), dbkey_t {2, step+1, 0});
+}
+
+TEST(incremental) {
+    g_TEST_incremental_checks = 0;
+    FilterInterface i {
+        filter_name: "TEST",
+        filter_type: SINGLE_ENTRY,
+        should_run: &g_TEST_incremental_sroe,
+        init: nullptr,
+        destroy: nullptr,
+        run: &g_TEST_incremental_run,
+        predicate: nullptr,
+        thread_safe: false
+    };
+
+    const vtx_t num_entries = 1000;
+    SeqDB d;
+    d.set_incremental(true);
+    for (vtx_t k = 0; k < num_entries; ++k) {
+        DBEntry<> e; e.add_tag("X"); e.set_key({1,k,0});
+        d.add_entry(move(e));
+    }
+    { DBEntry<> e; e.add_tag("A").value() = "0"; e.set_key({2,0,0}); d.add_entry(move(e)); }
+
+    d.install_filter(make_shared<Filter>(&i));
+    d.process();
+
+    // The first stage checks every entry; the rest only check the entry
+    // that was just marked done and the one it created
+    EQ(g_TEST_incremental_checks, (size_t)(num_entries+1 + 2+2+2+1));
+    EQ(d.size(), (size_t)(num_entries+4));
+    auto entries = d.entries();
+    for (vtx_t step = 0; step <= 3; ++step) {
+        dbkey_t key {2, step, 0};
+        NOPRINT_EQ(entries[key].has_tag("A:done"), true);
+    }
+
+    // A full scan can still be asked for
+    g_TEST_incremental_checks = 0;
+    d.request_full_scan();
+    EQ(d.process_once(), false);
+    EQ(g_TEST_incremental_checks, (size_t)(num_entries+4));
+
+    // Nothing has changed since
+    g_TEST_incremental_checks = 0;
+    EQ(d.process_once(), false);
+    EQ(g_TEST_incremental_checks, (size_t)0);
+
+    TEST_PASS
+}
+
 TEST(remove_tag_from_entry) {
     SeqDB db;
     DBEntry<> e;
@@ -800,6 +1041,73 @@ TEST(subscribe_to_entry) {
     TEST_PASS
 }
 
+size_t g_TEST_subscribe_ready_checks = 0;
+bool g_TEST_subscribe_ready_sroe(const DBAccess* acc) {
+    ++g_TEST_subscribe_ready_checks;
+    bool w = false, parked = false;
+    for (auto tags = acc->tags; *tags[0] != '\0'; ++tags) {
+        if (strcmp(*tags, "W") == 0) w = true;
+        if (strcmp(*tags, "W:inactive") == 0 || strcmp(*tags, "W:done") == 0) parked = true;
+    }
+    return w && !parked;
+}
+void g_TEST_subscribe_ready_run(void* access_raw) {
+    DBAccess* access = (DBAccess*)access_raw;
+    dbkey_t wait_key {1,1,1};
+    char* val = nullptr;
+    access->get_entry_by_key.run(&access->get_entry_by_key, wait_key, &val);
+    if (val == nullptr) {
+        access->add_tag.run(&access->add_tag, "W:inactive");
+        access->subscribe_to_entry.run(&access->subscribe_to_entry, access->key, wait_key, "W:inactive");
+        return;
+    }
+    free(val);
+    access->add_tag.run(&access->add_tag, "W:done");
+}
+
+TEST(subscribe_ready) {
+    g_TEST_subscribe_ready_checks = 0;
+    FilterInterface i {
+        filter_name: "TEST",
+        filter_type: SINGLE_ENTRY,
+        should_run: &g_TEST_subscribe_ready_sroe,
+        init: nullptr,
+        destroy: nullptr,
+        run: &g_TEST_subscribe_ready_run,
+        predicate: nullptr,
+        thread_safe: false
+    };
+
+    const vtx_t num_entries = 100;
+    SeqDB d;
+    d.set_incremental(true);
+    for (vtx_t k = 0; k < num_entries; ++k) {
+        DBEntry<> e; e.add_tag("X"); e.set_key({2,k,0});
+        d.add_entry(move(e));
+    }
+    dbkey_t my_key {0,0,0};
+    { DBEntry<> e; e.add_tag("W"); e.set_key(my_key); d.add_entry(move(e)); }
+
+    d.install_filter(make_shared<Filter>(&i));
+    d.process();
+    // Every entry, then the newly parked one
+    EQ(g_TEST_subscribe_ready_checks, (size_t)(num_entries+1 + 1));
+
+    // Creating the entry waited for wakes the parked entry, which is run
+    // straight away in the next stage, and checked once more after
+    g_TEST_subscribe_ready_checks = 0;
+    { DBEntry<> e; e.add_tag("Y"); e.set_key({1,1,1}); d.add_entry(move(e)); }
+    d.process();
+    EQ(g_TEST_subscribe_ready_checks, (size_t)3);
+    EQ(d.has_ready(), false);
+
+    auto entries = d.entries();
+    EQ(entries[my_key].has_tag("W:inactive"), false);
+    EQ(entries[my_key].has_tag("W:done"), true);
+
+    TEST_PASS
+}
+
 TEST(concat_stage) {
     SeqDB db;
 
@@ -885,6 +1193,30 @@ TEST(update_val) {
     TEST_PASS
 }
 
+TEST(ipc_map) {
+    SeqDB db;
+    db.use_ipc_map(true);
+    dbkey_t key = {10,10,10};
+    {
+        DBEntry<> e; e.value() = "foo"; e.set_key(key); e.add_tag("a");
+        db.add_entry(move(e));
+    }
+    db.stage_update_entry_val(key, "bar");
+    db.stage_add_tag(key, "b");
+    db.stage_close();
+
+    // Switching back sees the changes made over ZMQ
+    db.use_ipc_map(false);
+    EQ(db.size(), 1);
+    for (auto &[key, entry] : db.entries()) {
+        EQ(entry.value(), "bar");
+        EQ(entry.has_tag("a"), true);
+        EQ(entry.has_tag("b"), true);
+    }
+
+    TEST_PASS
+}
+
 TEST(serialize_entries) {
     //SeqDB db { data_dir+"/simple_bitcoin.txt" };
     SeqDB db;
@@ -1054,6 +1386,63 @@ TEST(import_export) {
     TEST_PASS
 }
 
+TEST(import_snapshot) {
+    const string fn = "exported_snapshot";
+    {
+        SeqDB db;
+        for (vtx_t i = 0; i < 10; ++i) {
+            DBEntry<> e; e.add_tag("a", i%2 ? "odd" : "even").value() = "v" + to_string(i);
+            e.set_key({0, 0, i});
+            db.add_entry(move(e));
+        }
+        db.export_db(fn);
+    }
+    EQ(Snapshot::is_snapshot(fn), true);
+
+    Snapshot snap {fn};
+    EQ(snap.size(), 10);
+    EQ(snap.unique_keys(), true);
+
+    // Only the accepted keys are loaded
+    SeqDB db2;
+    db2.import_db(fn, [](dbkey_t key) { return key.c < 6; });
+    EQ(db2.size(), 6);
+    EQ(db2.get_entry_by_tags({"odd"}).size(), 3);
+
+    // Keys that are already stored are merged as usual
+    db2.import_snapshot(snap);
+    EQ(db2.size(), 10);
+    auto entries = db2.entries();
+    dbkey_t k7 {0, 0, 7}, k2 {0, 0, 2};
+    EQ(entries[k7].value(), "v7");
+    EQ(entries[k7].has_tag("odd"), true);
+    EQ(entries[k2].value(), "v2");
+    EQ(db2.get_entry_by_tags({"even"}).size(), 5);
+
+    remove(fn.c_str());
+
+    TEST_PASS
+}
+
+TEST(import_legacy) {
+    const string fn = "exported_legacy";
+    {
+        SeqDB db { data_dir+"/simple_bitcoin.txt" };
+        pigo::WFile out_f {fn, db.serialize_size()};
+        char* data_ptr = (char*)out_f.fp();
+        db.serialize_entries(data_ptr);
+    }
+    EQ(Snapshot::is_snapshot(fn), false);
+
+    SeqDB db2;
+    db2.import_db(fn);
+    EQ(db2.size(), 2);
+
+    remove(fn.c_str());
+
+    TEST_PASS
+}
+
 TEST(sum_merge) {
     SeqDB db;
 
@@ -1110,10 +1499,10 @@ TEST(sum_merge) {
     //EQ(db.size(), 3);
     for (auto & [key, entry] : db.entries()) {
         if (key == k1) {
-            EQ(entry.value(), "3.000000");
+            EQ(entry.value(), "3");
             EQ(entry.has_tag("MERGED_SUM"), true);
         } else if (key == k2) {
-            EQ(entry.value(), "3.500000");
+            EQ(entry.value(), "3.5");
             EQ(entry.has_tag("MERGED_SUM"), true);
         } else if (key == k3) {
             bool match = entry.value() == "foo\nbar" || entry.value() == "bar\nfoo";
@@ -1128,6 +1517,142 @@ TEST(sum_merge) {
     TEST_PASS
 }
 
+TEST(merge_ops) {
+    SeqDB db;
+    auto add = [&](dbkey_t k, string value, string tag="") {
+        DBEntry<> e;
+        e.value() = value;
+        e.set_key(k);
+        if (!tag.empty()) e.add_tag(tag);
+        db.add_entry(move(e));
+    };
+
+    // Integer sums stay exact past double precision
+    dbkey_t sum_k {1,1,1};
+    add(sum_k, "9007199254740993", MERGE_STRATEGY_SUM);
+    add(sum_k, "2", MERGE_STRATEGY_SUM);
+    // Doubles keep their precision
+    dbkey_t small_k {1,1,2};
+    add(small_k, "0.0000001", MERGE_STRATEGY_SUM);
+    add(small_k, "0.0000002", MERGE_STRATEGY_SUM);
+
+    dbkey_t min_k {1,2,1};
+    add(min_k, "5", MERGE_STRATEGY_MIN);
+    add(min_k, "-2.5", MERGE_STRATEGY_MIN);
+    add(min_k, "3", MERGE_STRATEGY_MIN);
+    dbkey_t max_k {1,2,2};
+    add(max_k, "5", MERGE_STRATEGY_MAX);
+    add(max_k, "7", MERGE_STRATEGY_MAX);
+    add(max_k, "6", MERGE_STRATEGY_MAX);
+
+    // Counts are of the entries added, whatever their values
+    dbkey_t count_k {1,3,1};
+    add(count_k, "x", MERGE_STRATEGY_COUNT);
+    add(count_k, "x", MERGE_STRATEGY_COUNT);
+    add(count_k, "y", MERGE_STRATEGY_COUNT);
+    dbkey_t count_one_k {1,3,2};
+    add(count_one_k, "x", MERGE_STRATEGY_COUNT);
+
+    // Appending keeps identical values
+    dbkey_t append_k {1,4,1};
+    add(append_k, "a", MERGE_STRATEGY_APPEND);
+    add(append_k, "a", MERGE_STRATEGY_APPEND);
+
+    // A key family's strategy applies without tags
+    db.set_merge_strategy(0xff, 7, MERGE_STRATEGY_SUM);
+    dbkey_t family_k {7,1,1};
+    add(family_k, "4");
+    add(family_k, "4");
+    // and only to that family
+    dbkey_t other_k {8,1,1};
+    add(other_k, "4");
+    add(other_k, "4");
+
+    auto entries = db.entries();
+    EQ(entries[sum_k].value(), "9007199254740995");
+    EQ(entries[small_k].value(), "3e-07");
+    EQ(entries[min_k].value(), "-2.5");
+    EQ(entries[min_k].has_tag("MERGED_MIN"), true);
+    EQ(entries[max_k].value(), "7");
+    EQ(entries[max_k].has_tag("MERGED_MAX"), true);
+    EQ(entries[count_k].value(), "3");
+    EQ(entries[count_k].has_tag("MERGED_COUNT"), true);
+    EQ(entries[count_one_k].value(), "1");
+    EQ(entries[append_k].value(), "a\na");
+    EQ(entries[family_k].value(), "8");
+    EQ(entries[family_k].has_tag("MERGED_SUM"), true);
+    EQ(entries[other_k].value(), "4");
+
+    TEST_PASS
+}
+
+TEST(compact_map) {
+    SeqDB db;
+    dbkey_t k {1,1,1};
+    { DBEntry<> e; e.clear().add_tag("A"); e.value() = "0"; e.set_key(k); db.add_entry(move(e)); }
+
+    // Compaction is off by default
+    db.update_entry_val(k, string(3000, 'a'));
+    EQ(db.compact_if_fragmented(), false);
+
+    // Growing the value leaves the smaller ones behind
+    db.set_compact_threshold(0.25);
+    db.update_entry_val(k, string(4000, 'b'));
+    EQ(db.compact_if_fragmented(), true);
+    EQ(db.compact_if_fragmented(), false);
+
+    auto entries = db.entries();
+    auto & e = entries[k];
+    EQ(e.value(), string(4000, 'b'));
+    EQ(e.has_tag("A"), true);
+
+    TEST_PASS
+}
+
+TEST(aggregate) {
+    SeqDB db;
+
+    auto add = [&](dbkey_t key, string month, string value) {
+        DBEntry<> e;
+        e.set_key(key);
+        e.add_tag("out_val_usd", "month=" + month);
+        e.value() = value;
+        db.add_entry(move(e));
+    };
+    add({1,1,1}, "2020-01", "10.5");
+    add({1,2,1}, "2020-01", "4.5\n");
+    add({2,3,1}, "2020-02", "7");
+    add({2,4,1}, "2020-02", "n/a");
+    { DBEntry<> e; dbkey_t key {3,5,1}; e.set_key(key); e.add_tag("out_val_usd"); e.value() = "100"; db.add_entry(move(e)); }
+    { DBEntry<> e; dbkey_t key {3,6,1}; e.set_key(key); e.add_tag("other"); e.value() = "1000"; db.add_entry(move(e)); }
+
+    auto all = db.aggregate({"out_val_usd"}, "");
+    EQ(all.size(), 1);
+    EQ(all[""].count, 5);
+    EQ(all[""].values, 4);
+    FEQ(all[""].sum, 122);
+    FEQ(all[""].min, 4.5);
+    FEQ(all[""].max, 100);
+
+    // Entries without the prefix are left out of the groups
+    auto by_month = db.aggregate({"out_val_usd"}, "month=");
+    EQ(by_month.size(), 2);
+    EQ(by_month["2020-01"].count, 2);
+    FEQ(by_month["2020-01"].sum, 15);
+    FEQ(by_month["2020-01"].mean(), 7.5);
+    EQ(by_month["2020-02"].count, 2);
+    EQ(by_month["2020-02"].values, 1);
+    FEQ(by_month["2020-02"].max, 7);
+
+    auto by_a = db.aggregate({"out_val_usd"}, "key.a");
+    EQ(by_a.size(), 3);
+    FEQ(by_a["3"].sum, 100);
+
+    EQ(db.aggregate({"missing"}, "").size(), 0);
+
+    TEST_PASS
+}
+
 TESTS_BEGIN
     elga::ZMQChatterbox::Setup();
 
@@ -1152,19 +1677,30 @@ TESTS_BEGIN
     RUN_TEST(get_entry_value_by_key)
     RUN_TEST(get_entry_by_tags_access)
     RUN_TEST(install_filter_fi)
+    RUN_TEST(install_filter_fi_ipc)
+    RUN_TEST(install_filter_predicate)
+    RUN_TEST(filter_threads)
+    RUN_TEST(incremental)
     RUN_TEST(remove_tag_from_entry)
     RUN_TEST(add_tag_later)
     RUN_TEST(clear_filters)
     RUN_TEST(subscribe_to_entry)
+    RUN_TEST(subscribe_ready)
     RUN_TEST(concat_stage)
     RUN_TEST(concat_previously_exist)
     RUN_TEST(update_val)
+    RUN_TEST(ipc_map)
     RUN_TEST(key_collision)
     RUN_TEST(random_key)
     RUN_TEST(random_key_stage_close)
     RUN_TEST(serialize_entries)
     RUN_TEST(import_export)
+    RUN_TEST(import_snapshot)
+    RUN_TEST(import_legacy)
     RUN_TEST(sum_merge)
+    RUN_TEST(merge_ops)
+    RUN_TEST(compact_map)
+    RUN_TEST(aggregate)
 
     elga::ZMQChatterbox::Teardown();
 TESTS_END